@@ -0,0 +1,179 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#include "AsyncClient.h"
+
+#include <stdexcept>
+#include "Lanes.h"
+#include "Trace.h"
+#include "TreeEvaluator.h"
+
+/**
+ * Starts the three stage threads.
+ * @param encryptor the client's encryptor; its secret key decrypts the results.
+ * @param server sends a query to the server, see Server.
+ * @param client the ID every query names as its client, see Query::client.
+ */
+AsyncClient::AsyncClient(COED::Encryptor &encryptor, Server server, const std::string &client)
+        : encryptor(encryptor), server(std::move(server)), client(client) {
+    encrypt_thread = std::thread(&AsyncClient::encrypt_stage, this);
+    submit_thread = std::thread(&AsyncClient::submit_stage, this);
+    decrypt_thread = std::thread(&AsyncClient::decrypt_stage, this);
+}
+
+/**
+ * Finishes every query already submitted, then stops the stage threads.
+ */
+AsyncClient::~AsyncClient() {
+    to_encrypt.close();
+    encrypt_thread.join();
+    to_submit.close();
+    submit_thread.join();
+    to_decrypt.close();
+    decrypt_thread.join();
+}
+
+/**
+ * Queues several rows to be evaluated together, row r in lane r.
+ * @param rows at most Lanes::count rows of equal length, one value per feature; a single row with
+ * Upload::PACKED_FEATURES.
+ * @param upload how the rows are encrypted; must be what the server expects.
+ * @param model the ID of the model to evaluate, or empty for the server's default.
+ * @return the result of each row, or the exception thrown by any stage.
+ */
+std::future<std::vector<long>> AsyncClient::submit(std::vector<std::vector<int>> rows, Upload upload,
+                                                   const std::string &model) {
+    std::unique_ptr<Job> job(new Job);
+    job->rows = std::move(rows);
+    job->upload = upload;
+    job->model = model;
+    std::future<std::vector<long>> decoded = job->decoded.get_future();
+    to_encrypt.push(std::move(job));
+    return decoded;
+}
+
+/**
+ * Queues a single row.
+ * @param row one value per feature.
+ * @param upload how the row is encrypted; must be what the server expects.
+ * @param model the ID of the model to evaluate, or empty for the server's default.
+ * @return the result of the row.
+ */
+std::future<long> AsyncClient::submit(const std::vector<int> &row, Upload upload, const std::string &model) {
+    std::unique_ptr<Job> job(new Job);
+    job->rows.push_back(row);
+    job->upload = upload;
+    job->model = model;
+    job->single.reset(new std::promise<long>());
+    std::future<long> result = job->single->get_future();
+    to_encrypt.push(std::move(job));
+    return result;
+}
+
+/**
+ * Reads the results of a batch from one decryption: lane k holds the binary representation of row k's result, MSB
+ * first, like the inputs made by TreeEvaluator::getCtxt.
+ * @param slots the decrypted slots.
+ * @param rows the number of lanes to decode.
+ * @return one value per lane.
+ */
+std::vector<long> AsyncClient::decode(const std::vector<long> &slots, long rows) {
+    std::vector<long> values(rows, 0);
+    for (long lane = 0; lane < rows; lane++) {
+        for (int index = 0; index < BIT_SIZE; index++) {
+            values[lane] = 2 * values[lane] + slots.at(lane * BIT_SIZE + index);
+        }
+    }
+    return values;
+}
+
+/**
+ * Fails the query with {@code error}, through whichever future submit returned.
+ */
+void AsyncClient::Job::fail(std::exception_ptr error) {
+    if (single) {
+        single->set_exception(error);
+    } else {
+        decoded.set_exception(error);
+    }
+}
+
+void AsyncClient::encrypt_stage() {
+    helib::Context &context = *encryptor.getContext();
+    helib::PubKey &pubkey = *encryptor.getPublicKey();
+
+    std::unique_ptr<Job> job;
+    while (to_encrypt.pop(job)) {
+        try {
+            if (job->rows.empty())
+                throw std::invalid_argument("no rows to evaluate");
+            if (job->upload == Upload::PACKED_FEATURES) {
+                if (job->rows.size() != 1)
+                    throw std::invalid_argument("a packed upload carries a single row");
+                job->inputs.push_back(TreeEvaluator::getPackedCtxt(context, pubkey, job->rows[0]));
+            } else {
+                if (job->upload == Upload::SEEDED && !seeded)
+                    seeded.reset(new COED::SeededCtxt(*encryptor.getSecretKey()));
+                size_t features = job->rows[0].size();
+                for (size_t feature = 0; feature < features; feature++) {
+                    std::vector<int> column;
+                    for (const std::vector<int> &row : job->rows) {
+                        if (row.size() != features)
+                            throw std::invalid_argument("rows of different lengths");
+                        column.push_back(row[feature]);
+                    }
+                    if (job->upload == Upload::SEEDED) {
+                        job->seeded_inputs.push_back(seeded->encrypt(Lanes::encodePerLane(context, column)));
+                    } else {
+                        job->inputs.push_back(Lanes::encryptPerLane(context, pubkey, column));
+                    }
+                }
+            }
+            to_submit.push(std::move(job));
+        } catch (...) {
+            job->fail(std::current_exception());
+        }
+    }
+}
+
+void AsyncClient::submit_stage() {
+    std::unique_ptr<Job> job;
+    while (to_submit.pop(job)) {
+        try {
+            Query query;
+            query.inputs = std::move(job->inputs);
+            query.seeded_inputs = std::move(job->seeded_inputs);
+            query.upload = job->upload;
+            query.rows = job->rows.size();
+            query.model = job->model;
+            query.client = client;
+            job->result = server(std::move(query));
+            to_decrypt.push(std::move(job));
+        } catch (...) {
+            job->fail(std::current_exception());
+        }
+    }
+}
+
+void AsyncClient::decrypt_stage() {
+    const helib::EncryptedArray &ea = *encryptor.getEncryptedArray();
+
+    std::unique_ptr<Job> job;
+    while (to_decrypt.pop(job)) {
+        try {
+            helib::Ctxt result = job->result.get();
+            std::vector<long> slots(ea.size());
+            HTE_TRACE_OP("decrypt", result, ea.decrypt(result, *encryptor.getSecretKey(), slots));
+            std::vector<long> values = AsyncClient::decode(slots, job->rows.size());
+            if (job->single) {
+                job->single->set_value(values.at(0));
+            } else {
+                job->decoded.set_value(values);
+            }
+        } catch (...) {
+            job->fail(std::current_exception());
+        }
+    }
+}
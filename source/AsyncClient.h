@@ -0,0 +1,109 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#ifndef HOMOMORPHICTREEEVALUATOR_ASYNCCLIENT_H
+#define HOMOMORPHICTREEEVALUATOR_ASYNCCLIENT_H
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BlockingQueue.h"
+#include "Encryptor.h"
+#include "SeededCtxt.h"
+
+/**
+ * The client side as a library: submit plaintext queries, get futures of their decrypted results.
+ *
+ * Queries move through three stages, each on its own thread: encryption, submission to the server, and waiting for
+ * the server's answer and decrypting it. While query k is being evaluated, query k+1 is being encrypted and query k-1
+ * decrypted. Several rows can be submitted together; they travel in the lanes of one ciphertext per feature (see
+ * Lanes.h), and their result is decrypted once and decoded lane by lane.
+ */
+class AsyncClient {
+public:
+    /**
+     * How a query is uploaded: one ciphertext per feature with row r in lane r, or a single row with feature f in
+     * lane f (see TreeEvaluator::getPackedCtxt). SEEDED is PER_FEATURE encrypted under the secret key and sent in the
+     * format of SeededCtxt, about half the size; the server expands it with SeededCtxt::expand.
+     */
+    enum class Upload {
+        PER_FEATURE, PACKED_FEATURES, SEEDED
+    };
+
+    /**
+     * A query as it is sent to the server.
+     */
+    struct Query {
+        // The encrypted inputs; empty for a SEEDED upload.
+        std::vector<helib::Ctxt> inputs;
+        // One SeededCtxt per feature, for a SEEDED upload.
+        std::vector<std::string> seeded_inputs;
+        Upload upload;
+        long rows;
+        // The ID of the model to evaluate, or empty for the server's default.
+        std::string model;
+        // The ID of the client whose keys the inputs are encrypted under (see KeyCache), or empty for the server's own.
+        std::string client;
+    };
+
+    /**
+     * Sends a query to the server. The returned future becomes ready when the server has answered, so a server that
+     * evaluates asynchronously (e.g. through EvaluationScheduler) can have several queries in flight.
+     */
+    typedef std::function<std::future<helib::Ctxt>(Query query)> Server;
+
+    AsyncClient(COED::Encryptor &encryptor, Server server, const std::string &client = "");
+
+    ~AsyncClient();
+
+    std::future<std::vector<long>> submit(std::vector<std::vector<int>> rows, Upload upload = Upload::PER_FEATURE,
+                                          const std::string &model = "");
+
+    std::future<long> submit(const std::vector<int> &row, Upload upload = Upload::PER_FEATURE,
+                             const std::string &model = "");
+
+    static std::vector<long> decode(const std::vector<long> &slots, long rows);
+
+private:
+    struct Job {
+        std::vector<std::vector<int>> rows;
+        Upload upload;
+        std::string model;
+        std::vector<helib::Ctxt> inputs;
+        std::vector<std::string> seeded_inputs;
+        std::future<helib::Ctxt> result;
+        std::promise<std::vector<long>> decoded;
+        // Set instead of decoded for a query submitted as a single row.
+        std::unique_ptr<std::promise<long>> single;
+
+        void fail(std::exception_ptr error);
+    };
+
+    void encrypt_stage();
+
+    void submit_stage();
+
+    void decrypt_stage();
+
+    COED::Encryptor &encryptor;
+    Server server;
+    std::string client;
+    // Made by the encryption stage on the first SEEDED upload, and only used there.
+    std::unique_ptr<COED::SeededCtxt> seeded;
+
+    COED::BlockingQueue<std::unique_ptr<Job>> to_encrypt;
+    COED::BlockingQueue<std::unique_ptr<Job>> to_submit;
+    COED::BlockingQueue<std::unique_ptr<Job>> to_decrypt;
+
+    std::thread encrypt_thread;
+    std::thread submit_thread;
+    std::thread decrypt_thread;
+};
+
+
+#endif //HOMOMORPHICTREEEVALUATOR_ASYNCCLIENT_H
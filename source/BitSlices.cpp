@@ -0,0 +1,214 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#include "BitSlices.h"
+
+#include <stdexcept>
+#include "EncodedModel.h"
+#include "Trace.h"
+#include "TreeEvaluator.h"
+
+/**
+ * @param ea the EncryptedArray of the context.
+ * @return how many queries a bit-sliced batch holds: one per slot.
+ */
+long BitSlices::count(const helib::EncryptedArray &ea) {
+    return ea.size();
+}
+
+/**
+ * @param tree the model; it must have at least one decision.
+ * @param pubkey the client's public key.
+ * @param ea the EncryptedArray of the key's context.
+ * @return the model ready for evaluate.
+ */
+std::shared_ptr<const BitSlices::Model> BitSlices::encode(const DecisionTree &tree, helib::PubKey &pubkey,
+                                                          const helib::EncryptedArray &ea) {
+    std::vector<long> ones(ea.size(), 1);
+    helib::Ctxt one(pubkey);
+    ea.encrypt(one, pubkey, ones);
+    return std::shared_ptr<const Model>(new Model{tree, LeafPolynomial::compile(tree, false), one});
+}
+
+/**
+ * @param pubkey the client's public key.
+ * @param ea the EncryptedArray of the key's context.
+ * @param values at most count(ea) values, value q going to slot q, each in DecisionTree::laneRange().
+ * @return BIT_SIZE ciphertexts, the one at position j holding bit j (MSB first) of every value, as getBin writes it.
+ */
+std::vector<helib::Ctxt> BitSlices::encrypt(helib::PubKey &pubkey, const helib::EncryptedArray &ea,
+                                            const std::vector<int> &values) {
+    if ((long) values.size() > BitSlices::count(ea))
+        throw std::invalid_argument("more values than slots");
+    for (int value : values) {
+        if (!DecisionTree::fitsLane(value))
+            throw std::invalid_argument(std::to_string(value) + " is outside " + DecisionTree::laneRange());
+    }
+    std::vector<std::vector<long>> slots(BIT_SIZE, std::vector<long>(ea.size(), 0));
+    for (size_t q = 0; q < values.size(); q++) {
+        int bin[BIT_SIZE];
+        getBin(values[q], bin);
+        for (int j = 0; j < BIT_SIZE; j++) {
+            slots[j][q] = bin[j];
+        }
+    }
+
+    std::vector<helib::Ctxt> bits;
+    for (int j = 0; j < BIT_SIZE; j++) {
+        bits.emplace_back(pubkey);
+        HTE_TRACE_OP("encrypt", bits.back(), ea.encrypt(bits.back(), pubkey, slots[j]));
+    }
+    return bits;
+}
+
+/**
+ * Reads back bit-sliced values, e.g. the result of evaluate, the same way AsyncClient::decode reads lanes.
+ * @param bits BIT_SIZE ciphertexts, MSB first.
+ * @param secret_key the key they are encrypted under.
+ * @param ea the EncryptedArray of the key's context.
+ * @param count the number of slots to read.
+ * @return one value per slot.
+ */
+std::vector<long> BitSlices::decrypt(const std::vector<helib::Ctxt> &bits, const helib::SecKey &secret_key,
+                                     const helib::EncryptedArray &ea, long count) {
+    std::vector<long> values(count, 0);
+    std::vector<long> slots(ea.size());
+    for (const helib::Ctxt &bit : bits) {
+        HTE_TRACE_OP("decrypt", bit, ea.decrypt(bit, secret_key, slots));
+        for (long q = 0; q < count; q++) {
+            values[q] = 2 * values[q] + slots.at(q);
+        }
+    }
+    return values;
+}
+
+/**
+ * Compares bit-sliced values against a plaintext threshold: the MSB of x + (-t), like compareCtxt, with the carry
+ * rippling from the LSB ciphertext to the MSB one. With y the bits of -t, the carry out of bit j is x_j c where y_j
+ * is 0 and x_j + c + x_j c where it is 1, so every bit costs one multiplication and no rotation. The carry starts at
+ * zero and is left out until the first 1 of y. The sum wraps like that of compareCtxt, so x and t are kept to
+ * DecisionTree::laneRange(), as encrypt and DecisionTree::validate ensure.
+ * @param bits the BIT_SIZE ciphertexts of x, MSB first.
+ * @param threshold the threshold t.
+ * @return 1 in every slot where x < t, 0 elsewhere.
+ */
+helib::Ctxt BitSlices::lessThan(const std::vector<helib::Ctxt> &bits, int threshold) {
+    if (bits.size() != BIT_SIZE)
+        throw std::invalid_argument("a bit-sliced value has " + std::to_string(BIT_SIZE) + " ciphertexts");
+    if (!DecisionTree::fitsLane(threshold))
+        throw std::invalid_argument("threshold " + std::to_string(threshold) + " is outside " +
+                                    DecisionTree::laneRange());
+    int y[BIT_SIZE];
+    getBin(-threshold, y);
+
+    std::unique_ptr<helib::Ctxt> carry;
+    for (int j = BIT_SIZE - 1; j > 0; j--) {
+        if (!carry) {
+            if (y[j] == 1)
+                carry.reset(new helib::Ctxt(bits[j]));
+        } else if (y[j] == 0) {
+            HTE_TRACE_OP("multiplyBy", *carry, carry->multiplyBy(bits[j]));
+        } else {
+            helib::Ctxt both(*carry);
+            HTE_TRACE_OP("multiplyBy", both, both.multiplyBy(bits[j]));
+            *carry += bits[j];
+            *carry += both;
+        }
+    }
+
+    helib::Ctxt msb(bits[0]);
+    if (y[0] == 1)
+        msb.addConstant(1L);
+    if (carry)
+        msb += *carry;
+    return msb;
+}
+
+/**
+ * Compares bit-sliced values with a plaintext value: the product of x_j + c_j + 1 over every bit j, multiplied as a
+ * balanced tree in log2(BIT_SIZE) levels.
+ * @param bits the BIT_SIZE ciphertexts of x, MSB first.
+ * @param value the value c.
+ * @return 1 in every slot where x == c, 0 elsewhere.
+ */
+helib::Ctxt BitSlices::equal(const std::vector<helib::Ctxt> &bits, int value) {
+    if (bits.size() != BIT_SIZE)
+        throw std::invalid_argument("a bit-sliced value has " + std::to_string(BIT_SIZE) + " ciphertexts");
+    int c[BIT_SIZE];
+    getBin(value, c);
+
+    std::vector<helib::Ctxt> factors;
+    for (int j = 0; j < BIT_SIZE; j++) {
+        factors.push_back(bits[j]);
+        if (c[j] == 0)
+            factors.back().addConstant(1L);
+    }
+    for (size_t width = 1; width < factors.size(); width *= 2) {
+        for (size_t j = 0; j + width < factors.size(); j += 2 * width) {
+            HTE_TRACE_OP("multiplyBy", factors[j], factors[j].multiplyBy(factors[j + width]));
+        }
+    }
+    return factors[0];
+}
+
+/**
+ * Evaluates a model on a batch of bit-sliced queries.
+ * @param features one bit-sliced value per feature of the model, see encrypt.
+ * @param model the model, see encode.
+ * @return the BIT_SIZE ciphertexts of the result, MSB first: bit j is the sum of the indicators of the paths whose
+ * leaf has bit j set.
+ */
+std::vector<helib::Ctxt> BitSlices::evaluate(const std::vector<std::vector<helib::Ctxt>> &features,
+                                             const Model &model) {
+    const DecisionTree &tree = model.tree;
+    if ((int) features.size() != tree.getFeatureCount())
+        throw std::invalid_argument("expected " + std::to_string(tree.getFeatureCount()) + " features");
+
+    std::vector<helib::Ctxt> decisions;
+    for (int i = 0; i < tree.getNodeCount(); i++) {
+        const DecisionTree::Node &node = tree.getNode(i);
+        const std::vector<helib::Ctxt> &x = features[node.feature];
+        if (node.test == DecisionTree::Test::EQUAL) {
+            decisions.push_back(BitSlices::equal(x, node.threshold));
+        } else if (node.test == DecisionTree::Test::RANGE) {
+            // x < hi and not x < lo; modulo 2 the difference is a sum.
+            decisions.push_back(BitSlices::lessThan(x, node.upper));
+            decisions.back() += BitSlices::lessThan(x, node.threshold);
+        } else {
+            decisions.push_back(BitSlices::lessThan(x, node.threshold));
+        }
+    }
+    std::vector<helib::Ctxt> paths = model.polynomial.evaluateTerms(
+            decisions, [](int) -> const helib::Ctxt & { throw std::logic_error("the plan has no leaves"); },
+            model.one);
+
+    const std::vector<int> &leaves = model.polynomial.getTermLeaves();
+    std::vector<helib::Ctxt> result;
+    for (int j = 0; j < BIT_SIZE; j++) {
+        helib::Ctxt bit(model.one);
+        bit.addCtxt(model.one, true);
+        for (size_t path = 0; path < paths.size(); path++) {
+            int bin[BIT_SIZE];
+            getBin(tree.getLeafValue(leaves[path]), bin);
+            if (bin[j] == 1)
+                bit += paths[path];
+        }
+        result.push_back(bit);
+    }
+    return result;
+}
+
+/**
+ * The ciphertext memory one evaluate call holds at its peak, besides the model, as EncodedModel::evaluationBytes
+ * counts it: BIT_SIZE inputs per feature, one decision per node, the carry and product of lessThan, the live values of
+ * the path polynomial, one indicator per path and BIT_SIZE result bits.
+ * @param model the model.
+ * @return an estimate in bytes.
+ */
+size_t BitSlices::evaluationBytes(const Model &model) {
+    size_t ctxts = BIT_SIZE * model.tree.getFeatureCount() + model.tree.getNodeCount() + 2 +
+                   model.polynomial.getPeakValues() + model.polynomial.getTerms().size() + BIT_SIZE;
+    return ctxts * EncodedModel::ctxtBytes(model.one);
+}
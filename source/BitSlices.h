@@ -0,0 +1,58 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#ifndef HOMOMORPHICTREEEVALUATOR_BITSLICES_H
+#define HOMOMORPHICTREEEVALUATOR_BITSLICES_H
+
+#include <memory>
+#include <vector>
+#include <helib/helib.h>
+#include "DecisionTree.h"
+#include "LeafPolynomial.h"
+
+/**
+ * The transposed layout of Lanes: slot q holds query q and a value takes BIT_SIZE ciphertexts, ciphertext j holding
+ * bit j of every query, MSB first. A batch is as many queries as there are slots, BIT_SIZE times as many as lanes.
+ *
+ * Every bit of a query sits in the same slot, so the carry chain of a comparison never moves between slots: where
+ * compareCtxt rotates the carry into the next bit and broadcasts the sign bit across the lane, lessThan only
+ * multiplies and adds, bit ciphertext by bit ciphertext. The thresholds are plaintext constants, as in
+ * compareThresholds, and the leaf values are applied in the clear to the path indicators of the leaf polynomial, so an
+ * evaluation needs no rotation at all. The price is BIT_SIZE ciphertexts per feature and per result.
+ */
+class BitSlices {
+public:
+    /**
+     * A model prepared for bit-sliced evaluation: its tree, its leaf polynomial compiled without leaves and an
+     * all-ones ciphertext.
+     */
+    struct Model {
+        DecisionTree tree;
+        LeafPolynomial polynomial;
+        helib::Ctxt one;
+    };
+
+    static long count(const helib::EncryptedArray &ea);
+
+    static std::shared_ptr<const Model> encode(const DecisionTree &tree, helib::PubKey &pubkey,
+                                               const helib::EncryptedArray &ea);
+
+    static std::vector<helib::Ctxt> encrypt(helib::PubKey &pubkey, const helib::EncryptedArray &ea,
+                                            const std::vector<int> &values);
+
+    static std::vector<long> decrypt(const std::vector<helib::Ctxt> &bits, const helib::SecKey &secret_key,
+                                     const helib::EncryptedArray &ea, long count);
+
+    static helib::Ctxt lessThan(const std::vector<helib::Ctxt> &bits, int threshold);
+
+    static helib::Ctxt equal(const std::vector<helib::Ctxt> &bits, int value);
+
+    static std::vector<helib::Ctxt> evaluate(const std::vector<std::vector<helib::Ctxt>> &features, const Model &model);
+
+    static size_t evaluationBytes(const Model &model);
+};
+
+
+#endif //HOMOMORPHICTREEEVALUATOR_BITSLICES_H
@@ -0,0 +1,66 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#ifndef HOMOMORPHICTREEEVALUATOR_BLOCKINGQUEUE_H
+#define HOMOMORPHICTREEEVALUATOR_BLOCKINGQUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace COED {
+    /**
+     * An unbounded FIFO queue between pipeline stages. pop blocks until an item is available or the queue is closed.
+     */
+    template<typename T>
+    class BlockingQueue {
+    public:
+        void push(T item) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                items.push_back(std::move(item));
+            }
+            cv.notify_one();
+        }
+
+        /**
+         * @param item receives the next item.
+         * @return false once the queue is closed and empty.
+         */
+        bool pop(T &item) {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this] { return closed || !items.empty(); });
+            if (items.empty())
+                return false;
+            item = std::move(items.front());
+            items.pop_front();
+            return true;
+        }
+
+        /**
+         * Wakes every consumer; items already queued are still handed out.
+         */
+        void close() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                closed = true;
+            }
+            cv.notify_all();
+        }
+
+        size_t size() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return items.size();
+        }
+
+    private:
+        mutable std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<T> items;
+        bool closed = false;
+    };
+}
+
+#endif //HOMOMORPHICTREEEVALUATOR_BLOCKINGQUEUE_H
@@ -0,0 +1,367 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#include "BulkScorer.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <unistd.h>
+#include "AsyncClient.h"
+#include "BlockingQueue.h"
+#include "ExecutionPolicy.h"
+#include "Lanes.h"
+#include "MemoryBudget.h"
+#include "Trace.h"
+#include "TreeEvaluator.h"
+#include "Util.h"
+
+/**
+ * @param encryptor the keys rows are encrypted and results decrypted with.
+ * @param model the model to score with, encoded under the encryptor's public key.
+ * @param options the files and the number of workers.
+ */
+BulkScorer::BulkScorer(COED::Encryptor &encryptor, std::shared_ptr<const EncodedModel> model, Options options)
+        : encryptor(encryptor), model(std::move(model)), options(std::move(options)),
+          batch_rows(Lanes::count(*encryptor.getEncryptedArray())), batch_bytes(this->model->evaluationBytes()) {
+    if (this->options.checkpoint_path.empty()) {
+        this->options.checkpoint_path = this->options.output_path + ".checkpoint";
+    }
+    if (this->options.bit_sliced) {
+        const helib::EncryptedArray &ea = *encryptor.getEncryptedArray();
+        sliced_model = BitSlices::encode(this->model->getTree(), *encryptor.getPublicKey(), ea);
+        batch_rows = BitSlices::count(ea);
+        batch_bytes = BitSlices::evaluationBytes(*sliced_model);
+    }
+}
+
+/**
+ * Scores every row of the input not yet covered by the checkpoint.
+ * @return the number of rows scored by this call.
+ */
+long BulkScorer::run() {
+    long rows_done = 0, bytes_done = 0, records_done = 0;
+    std::ifstream checkpoint(options.checkpoint_path);
+    bool resuming = static_cast<bool>(checkpoint >> rows_done >> bytes_done);
+    if (resuming && !(checkpoint >> records_done))
+        records_done = 0;
+
+    std::ofstream out;
+    if (resuming) {
+        // Drop whatever was written after the checkpoint; those rows are scored again.
+        if (truncate(options.output_path.c_str(), bytes_done) != 0)
+            throw std::runtime_error("cannot resume " + options.output_path);
+        out.open(options.output_path, std::ios::app);
+        COED::Util::info("Resuming " + options.output_path + " after row " + std::to_string(rows_done));
+    } else {
+        out.open(options.output_path, std::ios::trunc);
+        const std::string header = "row,score\n";
+        out << header;
+        bytes_done = header.size();
+    }
+    if (!out)
+        throw std::runtime_error("cannot write " + options.output_path);
+    std::unique_ptr<COED::CtxtFileWriter> ciphertexts;
+    if (!options.ciphertext_path.empty()) {
+        if (resuming && rows_done > 0 && records_done == 0)
+            throw std::runtime_error(options.checkpoint_path + " is for a job that did not keep its ciphertexts");
+        ciphertexts = openCiphertexts(resuming ? records_done : 0);
+    }
+
+    std::ifstream in(options.input_path);
+    if (!in)
+        throw std::runtime_error("cannot read " + options.input_path);
+    std::vector<int> row;
+    for (long skipped = 0; skipped < rows_done; skipped++) {
+        if (!readRow(in, row))
+            throw std::runtime_error(options.input_path + " is shorter than its checkpoint");
+    }
+
+    COED::BlockingQueue<std::unique_ptr<Batch>> pending;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::map<long, std::unique_ptr<Batch>> done;
+    std::exception_ptr failure;
+
+    int worker_count = COED::MemoryBudget::concurrency(batch_bytes, std::max(1, options.workers));
+    if (worker_count < options.workers)
+        COED::Util::info("Scoring on " + std::to_string(worker_count) + " workers to fit the memory cap");
+    std::vector<std::thread> workers;
+    for (int i = 0; i < worker_count; i++) {
+        workers.emplace_back([&]() {
+            std::unique_ptr<Batch> batch;
+            while (pending.pop(batch)) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (failure)
+                        continue;
+                }
+                try {
+                    score(*batch);
+                    std::lock_guard<std::mutex> lock(mutex);
+                    done.emplace(batch->index, std::move(batch));
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    failure = std::current_exception();
+                }
+                cv.notify_all();
+            }
+        });
+    }
+
+    long read_batches = 0, written_batches = 0, rows_scored = 0;
+    // Writes every finished batch that has no unfinished batch before it. With {@code wait}, first waits for the
+    // next one to finish.
+    auto write = [&](bool wait) {
+        std::vector<std::unique_ptr<Batch>> ready;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (wait) {
+                cv.wait(lock, [&] { return failure || done.count(written_batches) > 0; });
+            }
+            if (failure)
+                std::rethrow_exception(failure);
+            for (auto it = done.find(written_batches); it != done.end(); it = done.find(written_batches)) {
+                ready.push_back(std::move(it->second));
+                done.erase(it);
+                written_batches++;
+            }
+        }
+        for (const std::unique_ptr<Batch> &batch : ready) {
+            std::ostringstream lines;
+            for (size_t r = 0; r < batch->rows.size(); r++) {
+                lines << batch->first_row + r << "," << batch->scores[r] << "\n";
+            }
+            out << lines.str();
+            bytes_done += lines.str().size();
+            rows_done += batch->rows.size();
+            rows_scored += batch->rows.size();
+            if (ciphertexts) {
+                for (const helib::Ctxt &ctxt : batch->ciphertexts) {
+                    ciphertexts->append(ctxt);
+                }
+                records_done += batch->ciphertexts.size();
+            }
+            if (batch->index % options.checkpoint_batches == options.checkpoint_batches - 1) {
+                out.flush();
+                if (ciphertexts)
+                    ciphertexts->flush();
+                saveCheckpoint(rows_done, bytes_done, records_done);
+            }
+        }
+        if (!out)
+            throw std::runtime_error("cannot write " + options.output_path);
+    };
+
+    try {
+        long next_row = rows_done + 1;
+        while (true) {
+            std::unique_ptr<Batch> batch(new Batch{read_batches, next_row, {}, {}, {}});
+            while ((long) batch->rows.size() < batch_rows && readRow(in, row)) {
+                batch->rows.push_back(row);
+            }
+            if (batch->rows.empty())
+                break;
+            next_row += batch->rows.size();
+            pending.push(std::move(batch));
+            read_batches++;
+            // Keeps at most two batches per worker in memory.
+            write(read_batches - written_batches >= 2 * (long) workers.size());
+        }
+        while (written_batches < read_batches) {
+            write(true);
+        }
+    } catch (...) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!failure)
+                failure = std::current_exception();
+        }
+        pending.close();
+        for (std::thread &worker : workers) {
+            worker.join();
+        }
+        bool flushed = static_cast<bool>(out.flush());
+        if (ciphertexts) {
+            try {
+                ciphertexts->flush();
+            } catch (const std::exception &e) {
+                COED::Util::error(e.what());
+                flushed = false;
+            }
+        }
+        if (flushed) {
+            saveCheckpoint(rows_done, bytes_done, records_done);
+        }
+        throw;
+    }
+    pending.close();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+
+    out.close();
+    if (!out)
+        throw std::runtime_error("cannot write " + options.output_path);
+    if (ciphertexts)
+        ciphertexts->close();
+    std::remove(options.checkpoint_path.c_str());
+    return rows_scored;
+}
+
+/**
+ * Encrypts the rows of a batch into lanes, or bit slices, evaluates the model on them and decrypts the scores.
+ * @param batch a batch of at most batch_rows rows.
+ */
+void BulkScorer::score(Batch &batch) const {
+    COED::MemoryBudget::Reservation reservation(batch_bytes);
+    COED::ExecutionPolicy::Lease lease;
+    helib::Context &context = *encryptor.getContext();
+    helib::PubKey &pubkey = *encryptor.getPublicKey();
+    const helib::EncryptedArray &ea = *encryptor.getEncryptedArray();
+
+    if (sliced_model) {
+        std::vector<std::vector<helib::Ctxt>> features;
+        for (int feature = 0; feature < model->getTree().getFeatureCount(); feature++) {
+            std::vector<int> column;
+            for (const std::vector<int> &values : batch.rows) {
+                column.push_back(values[feature]);
+            }
+            features.push_back(BitSlices::encrypt(pubkey, ea, column));
+        }
+        std::vector<helib::Ctxt> result = BitSlices::evaluate(features, *sliced_model);
+        batch.scores = BitSlices::decrypt(result, *encryptor.getSecretKey(), ea, batch.rows.size());
+        if (!options.ciphertext_path.empty())
+            batch.ciphertexts = std::move(result);
+        return;
+    }
+
+    std::vector<helib::Ctxt> inputs;
+    for (int feature = 0; feature < model->getTree().getFeatureCount(); feature++) {
+        std::vector<int> column;
+        for (const std::vector<int> &values : batch.rows) {
+            column.push_back(values[feature]);
+        }
+        inputs.push_back(Lanes::encryptPerLane(context, pubkey, column));
+    }
+    helib::Ctxt result = TreeEvaluator::evaluate_decision_tree(inputs.data(), *model, pubkey, context);
+
+    std::vector<long> slots(ea.size());
+    HTE_TRACE_OP("decrypt", result, ea.decrypt(result, *encryptor.getSecretKey(), slots));
+    batch.scores = AsyncClient::decode(slots, batch.rows.size());
+    if (!options.ciphertext_path.empty())
+        batch.ciphertexts.push_back(std::move(result));
+}
+
+/**
+ * Reads the next data row, skipping blank lines and a header line at the top of the file.
+ * @param in the input CSV.
+ * @param row receives the row.
+ * @return false at the end of the input.
+ */
+bool BulkScorer::readRow(std::istream &in, std::vector<int> &row) {
+    std::string line;
+    while (std::getline(in, line)) {
+        line_number++;
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+        bool parsed;
+        try {
+            parsed = BulkScorer::parseRow(line, row);
+        } catch (const std::out_of_range &e) {
+            throw std::runtime_error(options.input_path + ":" + std::to_string(line_number) + ": " + e.what());
+        }
+        if (!parsed && line_number == 1)
+            continue;
+        if (!parsed || (int) row.size() != model->getTree().getFeatureCount()) {
+            throw std::runtime_error(options.input_path + ":" + std::to_string(line_number) + ": expected " +
+                                     std::to_string(model->getTree().getFeatureCount()) + " integer features");
+        }
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @param line a comma-separated line.
+ * @param values receives the fields.
+ * @return false if a field is not an integer. An integer that does not fit a lane (see DecisionTree::fitsLane) throws
+ * std::out_of_range instead, so that the row is not mistaken for a header.
+ */
+bool BulkScorer::parseRow(const std::string &line, std::vector<int> &values) {
+    values.clear();
+    std::istringstream fields(line);
+    std::string field;
+    while (std::getline(fields, field, ',')) {
+        long value;
+        try {
+            size_t end;
+            value = std::stol(field, &end);
+            if (field.find_first_not_of(" \t\r", end) != std::string::npos)
+                return false;
+        } catch (const std::invalid_argument &) {
+            return false;
+        } catch (const std::out_of_range &) {
+            value = std::numeric_limits<long>::max();
+        }
+        if (!DecisionTree::fitsLane(value))
+            throw std::out_of_range("feature " + field + " is outside " + DecisionTree::laneRange());
+        values.push_back((int) value);
+    }
+    return true;
+}
+
+/**
+ * Opens the file the encrypted scores are kept in.
+ * @param records the records of a checkpoint being resumed, which are kept; 0 to start a new file.
+ * @return the writer, positioned after those records.
+ */
+std::unique_ptr<COED::CtxtFileWriter> BulkScorer::openCiphertexts(long records) const {
+    const std::string &path = options.ciphertext_path;
+    helib::Context &context = *encryptor.getContext();
+    if (records == 0)
+        return std::unique_ptr<COED::CtxtFileWriter>(new COED::CtxtFileWriter(path, context));
+
+    // A writer always starts a new file, so the records before the checkpoint are copied over from the old one. If an
+    // earlier resume was interrupted while copying, the old file is still where it moved it.
+    const std::string previous_path = path + ".resumed";
+    if (!std::ifstream(previous_path) && std::rename(path.c_str(), previous_path.c_str()) != 0)
+        throw std::runtime_error("cannot resume " + path);
+    std::unique_ptr<COED::CtxtFileWriter> writer(new COED::CtxtFileWriter(path, context));
+    {
+        COED::CtxtFileReader previous(previous_path, *encryptor.getPublicKey());
+        if ((long) previous.size() < records)
+            throw std::runtime_error(path + " is shorter than its checkpoint");
+        for (long record = 0; record < records; record++) {
+            writer->append(previous.read(record));
+        }
+        writer->flush();
+    }
+    std::remove(previous_path.c_str());
+    return writer;
+}
+
+/**
+ * Replaces the checkpoint atomically, so an interruption leaves either the old or the new one.
+ * @param rows the number of input rows whose scores are in the output.
+ * @param bytes the length of the output covering exactly those rows.
+ * @param records the number of ciphertext records covering exactly those rows.
+ */
+void BulkScorer::saveCheckpoint(long rows, long bytes, long records) const {
+    const std::string temporary_path = options.checkpoint_path + ".tmp";
+    {
+        std::ofstream checkpoint(temporary_path, std::ios::trunc);
+        checkpoint << rows << " " << bytes << " " << records << "\n";
+        if (!checkpoint)
+            throw std::runtime_error("cannot write " + temporary_path);
+    }
+    if (std::rename(temporary_path.c_str(), options.checkpoint_path.c_str()) != 0)
+        throw std::runtime_error("cannot write " + options.checkpoint_path);
+}
@@ -0,0 +1,89 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#ifndef HOMOMORPHICTREEEVALUATOR_BULKSCORER_H
+#define HOMOMORPHICTREEEVALUATOR_BULKSCORER_H
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BitSlices.h"
+#include "CtxtFile.h"
+#include "EncodedModel.h"
+#include "Encryptor.h"
+
+/**
+ * Scores a CSV file of feature rows offline. Rows are streamed from the input in batches of Lanes::count, one row per
+ * lane, encrypted with one ciphertext per feature, evaluated with evaluate_decision_tree and decrypted, on every core
+ * at once. With the bit-sliced layout a batch is BitSlices::count rows instead, one per slot, evaluated without
+ * rotations by BitSlices::evaluate. Results are appended to the output CSV as {@code row,score} in input order as soon as all earlier batches
+ * are done.
+ *
+ * Fewer workers than requested run if their batches would not fit the COED::MemoryBudget cap together.
+ *
+ * The encrypted scores can also be kept, in input order, in a COED::CtxtFileWriter file: one record per batch, or one
+ * per result bit with the bit-sliced layout.
+ *
+ * Progress is checkpointed next to the output: the number of rows, output bytes and ciphertext records known to be
+ * complete. A job started again with the same files resumes from there instead of from the first row; the checkpoint
+ * is removed when the job finishes.
+ */
+class BulkScorer {
+public:
+    struct Options {
+        std::string input_path;
+        std::string output_path;
+        // Defaults to the output path with ".checkpoint" appended.
+        std::string checkpoint_path;
+        int workers = std::max(1u, std::thread::hardware_concurrency());
+        // Batches written between checkpoints.
+        int checkpoint_batches = 16;
+        // Whether to evaluate in the BitSlices layout rather than in lanes.
+        bool bit_sliced = false;
+        // Where the encrypted scores are kept; empty to keep only the decrypted ones.
+        std::string ciphertext_path;
+    };
+
+    BulkScorer(COED::Encryptor &encryptor, std::shared_ptr<const EncodedModel> model, Options options);
+
+    long run();
+
+    static bool parseRow(const std::string &line, std::vector<int> &values);
+
+private:
+    struct Batch {
+        long index;
+        // The 1-based number of the first row of the batch.
+        long first_row;
+        std::vector<std::vector<int>> rows;
+        std::vector<long> scores;
+        // The encrypted scores, only if they are kept.
+        std::vector<helib::Ctxt> ciphertexts;
+    };
+
+    void score(Batch &batch) const;
+
+    bool readRow(std::istream &in, std::vector<int> &row);
+
+    std::unique_ptr<COED::CtxtFileWriter> openCiphertexts(long records) const;
+
+    void saveCheckpoint(long rows, long bytes, long records) const;
+
+    COED::Encryptor &encryptor;
+    std::shared_ptr<const EncodedModel> model;
+    Options options;
+    // Only set for the bit-sliced layout.
+    std::shared_ptr<const BitSlices::Model> sliced_model;
+    long batch_rows;
+    // The ciphertext memory scoring one batch takes, see COED::MemoryBudget.
+    size_t batch_bytes;
+    long line_number = 0;
+};
+
+
+#endif //HOMOMORPHICTREEEVALUATOR_BULKSCORER_H
@@ -0,0 +1,62 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#include "Channel.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <unistd.h>
+
+static bool writeAll(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+static bool readAll(int fd, char *data, size_t size) {
+    while (size > 0) {
+        ssize_t got = read(fd, data, size);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            return false;
+        data += got;
+        size -= got;
+    }
+    return true;
+}
+
+/**
+ * Writes {@code frame} preceded by its length.
+ * @param fd the descriptor to write to.
+ * @param frame the payload.
+ * @return false if the other end has gone away.
+ */
+bool COED::Channel::send(int fd, const std::string &frame) {
+    uint64_t size = frame.size();
+    return writeAll(fd, reinterpret_cast<const char *>(&size), sizeof(size)) &&
+           writeAll(fd, frame.data(), frame.size());
+}
+
+/**
+ * Reads one frame written by send.
+ * @param fd the descriptor to read from.
+ * @param frame receives the payload.
+ * @return false on end of file or error.
+ */
+bool COED::Channel::receive(int fd, std::string &frame) {
+    uint64_t size;
+    if (!readAll(fd, reinterpret_cast<char *>(&size), sizeof(size)))
+        return false;
+    frame.resize(size);
+    return readAll(fd, &frame[0], size);
+}
@@ -0,0 +1,24 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#ifndef HOMOMORPHICTREEEVALUATOR_CHANNEL_H
+#define HOMOMORPHICTREEEVALUATOR_CHANNEL_H
+
+#include <string>
+
+namespace COED {
+    /**
+     * Length-prefixed frames over a file descriptor (pipe or socket), so that serialized ciphertexts can be passed
+     * between processes without a separate framing protocol.
+     */
+    class Channel {
+    public:
+        static bool send(int fd, const std::string &frame);
+
+        static bool receive(int fd, std::string &frame);
+    };
+}
+
+#endif //HOMOMORPHICTREEEVALUATOR_CHANNEL_H
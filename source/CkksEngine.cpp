@@ -0,0 +1,284 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#include "CkksEngine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+// Odd sign approximations of degree 7 from Cheon, Kim and Kim, "Efficient homomorphic comparison methods with optimal
+// complexity" (2020): coefficients of x, x^3, x^5 and x^7. The steep one has slope about 4.5 at 0, the flat one is
+// flat at -1 and 1.
+static const double STEEP_SIGN[] = {4589.0 / 1024, -16577.0 / 1024, 25614.0 / 1024, -12860.0 / 1024};
+static const double FLAT_SIGN[] = {35.0 / 16, -35.0 / 16, 21.0 / 16, -5.0 / 16};
+
+/**
+ * Replaces x by c[0] x + c[1] x^3 + c[2] x^5 + c[3] x^7, in 3 levels.
+ * @param x the ciphertext to transform.
+ * @param c the coefficients.
+ */
+static void oddPolynomial(helib::Ctxt &x, const double c[4]) {
+    helib::Ctxt x2(x);
+    x2.square();
+    helib::Ctxt x3(x2);
+    x3.multiplyBy(x);
+    helib::Ctxt x4(x2);
+    x4.square();
+    helib::Ctxt x5(x4);
+    x5.multiplyBy(x);
+    helib::Ctxt x7(x4);
+    x7.multiplyBy(x3);
+
+    x.multByConstant(c[0]);
+    x3.multByConstant(c[1]);
+    x5.multByConstant(c[2]);
+    x7.multByConstant(c[3]);
+    x += x3;
+    x += x5;
+    x += x7;
+}
+
+/**
+ * Leaves and the all-ones ciphertext are filled in by CkksEngine::encode.
+ * @param tree the tree.
+ * @param pubkey the engine's key.
+ */
+CkksEngine::Model::Model(const DecisionTree &tree, const helib::PubKey &pubkey)
+        : tree(tree), polynomial(LeafPolynomial::compile(tree)), paths(LeafPolynomial::compile(tree, false)),
+          one(pubkey) {
+}
+
+/**
+ * Builds a CKKS context and generates a key pair. Only the public key is needed to evaluate.
+ * @param parameters the encryption parameters and the sign approximation.
+ */
+CkksEngine::CkksEngine(const Parameters &parameters) : parameters(parameters) {
+    // p = -1 selects CKKS.
+    context.reset(new helib::Context(parameters.m, -1, parameters.precision));
+    helib::buildModChain(*context, parameters.numOfBitsOfModulusChain, parameters.numOfColOfKeySwitchingMatrix);
+    ea.reset(new helib::EncryptedArray(*context));
+    secret_key.reset(new helib::SecKey(*context));
+    secret_key->GenSecKey();
+    // Rotations, for totalSums.
+    helib::addSome1DMatrices(*secret_key);
+}
+
+/**
+ * @return the number of queries a ciphertext carries.
+ */
+long CkksEngine::slotCount() const {
+    return context->zMStar.getNSlots();
+}
+
+/**
+ * @param tree the tree to encode.
+ * @return the tree with its leaf values encrypted under the engine's key.
+ */
+std::shared_ptr<const CkksEngine::Model> CkksEngine::encode(const DecisionTree &tree) const {
+    std::shared_ptr<Model> model(new Model(tree, *secret_key));
+    for (int leaf = 0; leaf < tree.getLeafCount(); leaf++) {
+        model->leaves.push_back(encryptReplicated(tree.getLeafValue(leaf)));
+    }
+    model->one = encryptReplicated(1);
+    return model;
+}
+
+/**
+ * @param rows at most slotCount() queries of equal length.
+ * @return one ciphertext per feature, holding query q in slot q.
+ */
+std::vector<helib::Ctxt> CkksEngine::encrypt(const std::vector<std::vector<double>> &rows) const {
+    if (rows.empty() || (long) rows.size() > slotCount())
+        throw std::invalid_argument("between 1 and " + std::to_string(slotCount()) + " rows fit in a ciphertext");
+
+    const helib::PubKey &pubkey = *secret_key;
+    std::vector<helib::Ctxt> features;
+    for (size_t feature = 0; feature < rows[0].size(); feature++) {
+        std::vector<double> column(slotCount(), 0);
+        for (size_t q = 0; q < rows.size(); q++) {
+            column[q] = rows[q].at(feature);
+        }
+        helib::Ptxt<helib::CKKS> ptxt(*context, column);
+        helib::Ctxt ctxt(pubkey);
+        pubkey.Encrypt(ctxt, ptxt);
+        features.push_back(ctxt);
+    }
+    return features;
+}
+
+/**
+ * Evaluates {@code model} on every query of a batch.
+ * @param model a model from encode.
+ * @param features the ciphertexts made by encrypt.
+ * @return the approximate leaf value of query q in slot q.
+ */
+helib::Ctxt CkksEngine::evaluate(const Model &model, const std::vector<helib::Ctxt> &features) const {
+    std::vector<helib::Ctxt> decisions = decide(model, features);
+    return model.polynomial.evaluate(decisions, [&model](int leaf) -> const helib::Ctxt & {
+        return model.leaves[leaf];
+    }, model.one);
+}
+
+/**
+ * Evaluates which leaf each query of a batch reaches, without the leaf values.
+ * @param model a model from encode.
+ * @param features the ciphertexts made by encrypt.
+ * @return one ciphertext per leaf, about 1 in the slots of the queries that reach it and about 0 elsewhere.
+ */
+std::vector<helib::Ctxt> CkksEngine::leafIndicators(const Model &model, const std::vector<helib::Ctxt> &features) const {
+    std::vector<helib::Ctxt> decisions = decide(model, features);
+    std::vector<helib::Ctxt> terms = model.paths.evaluateTerms(
+            decisions, [](int) -> const helib::Ctxt & { throw std::logic_error("the plan has no leaves"); },
+            model.one);
+
+    // A leaf ends exactly one path, so each indicator is a single term.
+    std::vector<helib::Ctxt> indicators(model.tree.getLeafCount(), model.one);
+    for (size_t term = 0; term < terms.size(); term++) {
+        indicators[model.paths.getTermLeaves()[term]] = terms[term];
+    }
+    return indicators;
+}
+
+/**
+ * The soft decision x < threshold, slot by slot.
+ * @param x a ciphertext of feature values.
+ * @param threshold the threshold, within range of every value of x.
+ * @return about 1 where x < threshold and about 0 where x > threshold.
+ */
+helib::Ctxt CkksEngine::compare(const helib::Ctxt &x, double threshold) const {
+    helib::Ctxt z(x);
+    z.addConstant(-threshold);
+    z.multByConstant(1.0 / parameters.range);
+    CkksEngine::sign(z, parameters.steep_iterations, parameters.flat_iterations);
+    z.multByConstant(-0.5);
+    z.addConstant(0.5);
+    return z;
+}
+
+/**
+ * Checks that every comparison of a query is within the range the sign approximation holds on: a feature farther than
+ * Parameters::range from a comparison point of its nodes (see decide) would get an arbitrary decision rather than an
+ * approximate one.
+ * @param tree the tree the query is for.
+ * @param row the features of the query.
+ */
+void CkksEngine::checkRange(const DecisionTree &tree, const std::vector<double> &row) const {
+    for (int node = 0; node < tree.getNodeCount(); node++) {
+        const DecisionTree::Node &n = tree.getNode(node);
+        double x = row.at(n.feature);
+        bool integral = tree.isIntegral(n.feature) || n.test == DecisionTree::Test::EQUAL;
+        std::vector<double> bounds = {n.real_threshold};
+        if (n.test != DecisionTree::Test::LESS_THAN)
+            bounds.push_back(n.test == DecisionTree::Test::RANGE ? n.real_upper : n.real_threshold + 1);
+        for (double bound : bounds) {
+            double point = CkksEngine::comparisonPoint(bound, integral);
+            if (std::abs(x - point) > parameters.range) {
+                std::ostringstream message;
+                message << "feature " << n.feature << " = " << x << " is farther than " << parameters.range
+                        << " from " << point << ", where node " << node << " compares it";
+                throw std::out_of_range(message.str());
+            }
+        }
+    }
+}
+
+/**
+ * Zeroes every slot outside [begin, end), e.g. the unused slots of a partial batch.
+ * @param ctxt the ciphertext to mask.
+ * @param begin the first slot to keep.
+ * @param end one past the last slot to keep.
+ */
+void CkksEngine::keepSlots(helib::Ctxt &ctxt, long begin, long end) const {
+    std::vector<double> mask(slotCount(), 0);
+    for (long slot = std::max(0L, begin); slot < std::min(end, slotCount()); slot++) {
+        mask[slot] = 1;
+    }
+    ctxt.multByConstant(helib::Ptxt<helib::CKKS>(*context, mask));
+}
+
+/**
+ * Replaces every slot of {@code ctxt} by the sum of all its slots, in log2(slotCount()) rotations.
+ * @param ctxt the ciphertext to sum up.
+ */
+void CkksEngine::totalSums(helib::Ctxt &ctxt) const {
+    helib::totalSums(*ea, ctxt);
+}
+
+/**
+ * @param result a ciphertext returned by evaluate.
+ * @param rows the number of queries in the batch.
+ * @return the result of each query.
+ */
+std::vector<double> CkksEngine::decrypt(const helib::Ctxt &result, long rows) const {
+    helib::Ptxt<helib::CKKS> ptxt(*context);
+    secret_key->Decrypt(ptxt, result);
+    std::vector<double> values(rows);
+    for (long q = 0; q < rows; q++) {
+        values[q] = ptxt[q].real();
+    }
+    return values;
+}
+
+/**
+ * Approximates sign(x) for every slot of x in [-1, 1], in 3 * (steep_iterations + flat_iterations) levels.
+ * @param ctxt the ciphertext to transform.
+ * @param steep_iterations the number of steep polynomials to compose first.
+ * @param flat_iterations the number of flat polynomials to compose after them.
+ */
+void CkksEngine::sign(helib::Ctxt &ctxt, int steep_iterations, int flat_iterations) {
+    for (int i = 0; i < steep_iterations; i++) {
+        oddPolynomial(ctxt, STEEP_SIGN);
+    }
+    for (int i = 0; i < flat_iterations; i++) {
+        oddPolynomial(ctxt, FLAT_SIGN);
+    }
+}
+
+helib::Ctxt CkksEngine::encryptReplicated(double value) const {
+    const helib::PubKey &pubkey = *secret_key;
+    helib::Ptxt<helib::CKKS> ptxt(*context, std::vector<double>(slotCount(), value));
+    helib::Ctxt ctxt(pubkey);
+    pubkey.Encrypt(ctxt, ptxt);
+    return ctxt;
+}
+
+/**
+ * Where a feature is compared with a bound. A real-valued feature is compared at the bound itself. An integral one is
+ * compared halfway to the integer below the bound rounded up, so that a feature equal to an integer bound gets about 0
+ * rather than 1/2.
+ * @param bound a threshold or bound of a node.
+ * @param integral whether the feature only takes integer values.
+ * @return the value x is compared with to decide x < bound.
+ */
+double CkksEngine::comparisonPoint(double bound, bool integral) {
+    return integral ? std::ceil(bound) - 0.5 : bound;
+}
+
+/**
+ * The soft decision of every node of a model. A range test is the difference of the comparisons with its bounds, and
+ * an equality test the range [value, value + 1) of an integral feature. A feature on a bound of an integral test, such
+ * as an exact match, is 1/2 away from both comparison points rather than on one of them.
+ * @param model a model from encode.
+ * @param features the ciphertexts made by encrypt.
+ * @return one decision per node.
+ */
+std::vector<helib::Ctxt> CkksEngine::decide(const Model &model, const std::vector<helib::Ctxt> &features) const {
+    std::vector<helib::Ctxt> decisions;
+    for (int node = 0; node < model.tree.getNodeCount(); node++) {
+        const DecisionTree::Node &n = model.tree.getNode(node);
+        const helib::Ctxt &x = features.at(n.feature);
+        bool integral = model.tree.isIntegral(n.feature) || n.test == DecisionTree::Test::EQUAL;
+        if (n.test == DecisionTree::Test::LESS_THAN) {
+            decisions.push_back(compare(x, CkksEngine::comparisonPoint(n.real_threshold, integral)));
+            continue;
+        }
+        double upper = n.test == DecisionTree::Test::RANGE ? n.real_upper : n.real_threshold + 1;
+        decisions.push_back(compare(x, CkksEngine::comparisonPoint(upper, integral)));
+        decisions.back() -= compare(x, CkksEngine::comparisonPoint(n.real_threshold, integral));
+    }
+    return decisions;
+}
@@ -0,0 +1,106 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#ifndef HOMOMORPHICTREEEVALUATOR_CKKSENGINE_H
+#define HOMOMORPHICTREEEVALUATOR_CKKSENGINE_H
+
+#include <memory>
+#include <vector>
+#include <helib/helib.h>
+#include "DecisionTree.h"
+#include "LeafPolynomial.h"
+
+/**
+ * Evaluates trees on real-valued features in CKKS, as an alternative to the bitwise BGV circuit of compareCtxt.
+ *
+ * Every slot holds one query: a query batch is one ciphertext per feature, with the value of query q in slot q. A node
+ * computes z = (x - threshold) / range and approximates sign(z) by composing low-degree odd polynomials, first a few
+ * steep ones that pull small differences away from 0, then a few flat ones that settle them at -1 or 1. The soft
+ * decision (1 - sign(z)) / 2 is close to 1 where x < threshold, and the decisions go through the same LeafPolynomial as
+ * in BGV. A comparison costs 3 levels per composed polynomial whatever the width of the features, against BIT_SIZE
+ * sequential multiplications per bit circuit, and every slot carries a query instead of every lane of BIT_SIZE slots.
+ *
+ * The result is approximate: features closer to a comparison point than about range * 2^-12 (1/4 with the default
+ * parameters) get decisions between 0 and 1, and so a blend of the leaves on both sides; one exactly on it gets 1/2.
+ * A real-valued feature is compared at the threshold itself, so this is the tolerance of a tie: a model whose features
+ * sit on its thresholds should declare them integral or move the thresholds between the values they take. An integral
+ * feature (see DecisionTree::isIntegral), and the feature of an equality test, is compared halfway below the threshold
+ * rounded up, which no integer is closer to than 1/2: x < t and x < ceil(t) - 1/2 agree on integers, and every such
+ * decision is within the precision of the approximation.
+ */
+class CkksEngine {
+public:
+    struct Parameters {
+        // A power of two; phi(m) / 2 slots.
+        long m = 32768;
+        // Bits of precision of the encoding.
+        long precision = 20;
+        long numOfBitsOfModulusChain = 900;
+        long numOfColOfKeySwitchingMatrix = 2;
+        // An upper bound on |feature - threshold|.
+        double range = 1024;
+        // Composed sign polynomials: steep ones first, then flat ones.
+        int steep_iterations = 5;
+        int flat_iterations = 2;
+    };
+
+    /**
+     * A tree ready for evaluation under the engine's key: its leaf polynomial, the same without leaves for
+     * leafIndicators, each leaf value encrypted in every slot, and an all-ones ciphertext.
+     */
+    class Model {
+    public:
+        Model(const DecisionTree &tree, const helib::PubKey &pubkey);
+
+        const DecisionTree tree;
+        const LeafPolynomial polynomial;
+        const LeafPolynomial paths;
+        std::vector<helib::Ctxt> leaves;
+        helib::Ctxt one;
+    };
+
+    explicit CkksEngine(const Parameters &parameters);
+
+    CkksEngine(const CkksEngine &) = delete;
+
+    CkksEngine &operator=(const CkksEngine &) = delete;
+
+    long slotCount() const;
+
+    std::shared_ptr<const Model> encode(const DecisionTree &tree) const;
+
+    std::vector<helib::Ctxt> encrypt(const std::vector<std::vector<double>> &rows) const;
+
+    helib::Ctxt evaluate(const Model &model, const std::vector<helib::Ctxt> &features) const;
+
+    std::vector<helib::Ctxt> leafIndicators(const Model &model, const std::vector<helib::Ctxt> &features) const;
+
+    helib::Ctxt compare(const helib::Ctxt &x, double threshold) const;
+
+    void checkRange(const DecisionTree &tree, const std::vector<double> &row) const;
+
+    void keepSlots(helib::Ctxt &ctxt, long begin, long end) const;
+
+    void totalSums(helib::Ctxt &ctxt) const;
+
+    std::vector<double> decrypt(const helib::Ctxt &result, long rows) const;
+
+    static void sign(helib::Ctxt &ctxt, int steep_iterations, int flat_iterations);
+
+private:
+    helib::Ctxt encryptReplicated(double value) const;
+
+    static double comparisonPoint(double bound, bool integral);
+
+    std::vector<helib::Ctxt> decide(const Model &model, const std::vector<helib::Ctxt> &features) const;
+
+    Parameters parameters;
+    std::unique_ptr<helib::Context> context;
+    std::unique_ptr<helib::EncryptedArray> ea;
+    std::unique_ptr<helib::SecKey> secret_key;
+};
+
+
+#endif //HOMOMORPHICTREEEVALUATOR_CKKSENGINE_H
@@ -3,45 +3,249 @@
 //
 
 #include "Client.h"
+
+#include <algorithm>
+#include <deque>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "EvaluationScheduler.h"
+#include "ExecutionPolicy.h"
+#include "KeyCache.h"
+#include "Lanes.h"
+#include "LruCache.h"
+#include "MemoryBudget.h"
+#include "ModelRegistry.h"
+#include "ModelStore.h"
+#include "Sharding.h"
 #include "TreeEvaluator.h"
 
-void Client::main() {
+// The memory encoded models of a registry may take together.
+static const size_t MODEL_CACHE_BYTES = 1UL << 30;
+// Piped queries read ahead of the oldest unanswered one; beyond this many, reading waits for its result.
+static const size_t MAX_PENDING = 64;
+// The memory the keys of a KeyCache may take together.
+static const size_t KEY_CACHE_BYTES = 1UL << 30;
+
+/**
+ * The model encoded under one client's key, with the key it needs.
+ */
+struct ClientModel {
+    std::shared_ptr<KeyCache::ClientKeys> keys;
+    std::shared_ptr<const EncodedModel> model;
+};
+
+/**
+ * Serves queries from std::cin until it is closed. If {@code model_path} is given the model is loaded from that file
+ * and reloaded in the background whenever the file changes, otherwise the tree from README.md is used.
+ * With {@code shards} > 0 the comparisons are split across that many forked worker processes instead; the model is
+ * then fixed for the lifetime of the process.
+ * With {@code models_directory}, every model in that directory is served from one ModelRegistry instead, and each
+ * query starts with the ID of the model it is for.
+ * Queries go through an AsyncClient, so when they are piped in, encrypting one overlaps with evaluating the one before;
+ * results are still printed in input order. From a terminal each result is printed before the next prompt.
+ * Single-row queries evaluated in this process go through an EvaluationScheduler: as interactive requests from a
+ * terminal, and as bulk requests, packed into the lanes of shared evaluations, when piped in. With a coalescing window
+ * every query is an interactive request, and concurrent ones are packed by the scheduler's QueryCoalescer instead.
+ * With {@code seeded_uploads}, queries sent one ciphertext per feature are encrypted under the secret key and uploaded
+ * in the seeded format of SeededCtxt, which the server expands before evaluating.
+ * With {@code keys_directory}, the server serves many clients, each with its own keys: every query carries the ID of
+ * its client, whose key is looked up in a KeyCache over that directory, and the model is encoded once per client
+ * under that key and cached. This process publishes its own key there as client {@code client_id}. The model is then
+ * fixed for the lifetime of the process.
+ * @param model_path the path of a model file, or an empty string.
+ * @param models_directory a directory of model files, or an empty string.
+ * @param shards the number of worker processes, or 0 to evaluate in this process.
+ * @param coalesce_ms the coalescing window of interactive requests, or 0 to evaluate each on its own.
+ * @param seeded_uploads whether to upload in the seeded format.
+ * @param keys_directory a directory of client keys, or an empty string to serve only this process's key.
+ * @param client_id the ID of this process as a client, with {@code keys_directory}.
+ */
+void Client::main(const std::string &model_path, const std::string &models_directory, int shards,
+                  double coalesce_ms, bool seeded_uploads, const std::string &keys_directory,
+                  const std::string &client_id) {
     COED::Encryptor encryptor = Client::createEncryptor();
 
-    helib::Ctxt ctxt_result = Client::send_input_vector(encryptor);
+    ModelStore models(*encryptor.getContext(), *encryptor.getPublicKey(),
+                      model_path.empty() ? DecisionTree::default_tree() : DecisionTree::load(model_path));
+    std::unique_ptr<ModelRegistry> registry;
+    std::unique_ptr<ShardCoordinator> coordinator;
+    if (!models_directory.empty()) {
+        registry.reset(new ModelRegistry(*encryptor.getContext(), *encryptor.getPublicKey(), MODEL_CACHE_BYTES));
+        COED::Util::info("Registered " + std::to_string(registry->load(models_directory)) + " models from " +
+                         models_directory);
+    } else if (shards > 0) {
+        coordinator.reset(new ShardCoordinator(models.current(), *encryptor.getContext(),
+                                               *encryptor.getPublicKey(), shards));
+    } else if (!model_path.empty() && keys_directory.empty()) {
+        models.watch(model_path, std::chrono::seconds(1));
+    }
+
+    std::unique_ptr<KeyCache> keys;
+    std::unique_ptr<COED::LruCache<const ClientModel>> client_models;
+    if (!keys_directory.empty()) {
+        // This process is the client; the server finds its key where it finds every other client's.
+        encryptor.writePublicKeyBinary(keys_directory + "/" + client_id + ".pk");
+        keys.reset(new KeyCache(keys_directory, KEY_CACHE_BYTES));
+        client_models.reset(new COED::LruCache<const ClientModel>(
+                "the model encoded for client", MODEL_CACHE_BYTES,
+                [](const ClientModel &client) { return client.model->footprint(); }));
+    }
+
+    // Queries typed at a terminal are answered one by one; piped queries are throughput work, which the scheduler
+    // packs into lanes. The scheduler evaluates under this process's key, so queries under a client's own key skip it.
+    bool interactive = isatty(STDIN_FILENO);
+    std::unique_ptr<EvaluationScheduler> scheduler;
+    if (coordinator == nullptr && keys == nullptr) {
+        EvaluationScheduler::Options scheduling;
+        scheduling.coalesce_ms = coalesce_ms;
+        scheduler.reset(new EvaluationScheduler(*encryptor.getContext(), *encryptor.getPublicKey(), scheduling));
+    }
+    EvaluationScheduler::Priority priority = interactive || coalesce_ms > 0 ? EvaluationScheduler::Priority::INTERACTIVE
+                                                                            : EvaluationScheduler::Priority::BULK;
+
+    AsyncClient client(encryptor, [&](AsyncClient::Query query) {
+        // The client's own keys, and the model encoded under them.
+        std::shared_ptr<const ClientModel> client_model;
+        if (keys) {
+            client_model = client_models->get(query.client, [&] {
+                std::shared_ptr<ClientModel> encoded = std::make_shared<ClientModel>();
+                encoded->keys = keys->get(query.client);
+                encoded->model = EncodedModel::encode(models.current()->getTree(), *encoded->keys->context,
+                                                      *encoded->keys->pubkey);
+                return encoded;
+            });
+        }
+        helib::Context &context = client_model ? *client_model->keys->context : *encryptor.getContext();
+        helib::PubKey &pubkey = client_model ? *client_model->keys->pubkey : *encryptor.getPublicKey();
+
+        if (query.upload == AsyncClient::Upload::SEEDED) {
+            // The random half of each ciphertext is regenerated from its seed; the rest is a per-feature upload.
+            for (const std::string &bytes : query.seeded_inputs) {
+                query.inputs.push_back(COED::SeededCtxt::expand(bytes, pubkey));
+            }
+            query.upload = AsyncClient::Upload::PER_FEATURE;
+        }
+        std::shared_ptr<const EncodedModel> model = client_model ? client_model->model
+                                                                 : query.model.empty() ? models.current()
+                                                                                       : registry->get(query.model);
+        if (scheduler && query.upload == AsyncClient::Upload::PER_FEATURE && query.rows == 1) {
+            std::cout << "Calculating result..." << std::endl;
+            EvaluationScheduler::Admission admission = scheduler->submit(std::move(query.inputs), model, priority);
+            if (!admission.accepted)
+                throw std::runtime_error("query rejected: " + admission.reason);
+            return std::move(admission.result);
+        }
+        COED::MemoryBudget::Reservation reservation(model->evaluationBytes());
+        COED::ExecutionPolicy::Lease lease;
+        std::promise<helib::Ctxt> result;
+        result.set_value(Client::send_input_vector(context, pubkey, *model, query.inputs, query.upload, query.rows,
+                                                   coordinator.get()));
+        return result.get_future();
+    }, client_id);
 
-    debugN(encryptor, ctxt_result, ">> Result :", 16);
+    std::deque<std::future<long>> pending;
+    while (true) {
+        std::string id;
+        std::shared_ptr<const DecisionTree> tree;
+        if (registry) {
+            if (interactive) {
+                std::cout << "Enter a model ID followed by its feature vectors." << std::endl;
+            }
+            if (!(std::cin >> id)) {
+                break;
+            }
+            try {
+                tree = registry->getTree(id);
+            } catch (const std::out_of_range &e) {
+                COED::Util::error(e.what());
+                std::string rest;
+                std::getline(std::cin, rest);
+                continue;
+            }
+        }
+        std::shared_ptr<const EncodedModel> model = models.current();
+        std::vector<int> inputs(tree ? tree->getFeatureCount() : model->getTree().getFeatureCount());
+        if (interactive && !registry) {
+            std::cout << "Enter " << inputs.size() << " feature vectors. Hit enter after each." << std::endl;
+        }
+        for (int &input : inputs) {
+            std::cin >> input;
+        }
+        if (!std::cin) {
+            break;
+        }
+        if (std::any_of(inputs.begin(), inputs.end(), [](int input) { return !DecisionTree::fitsLane(input); })) {
+            COED::Util::error("features must lie in " + DecisionTree::laneRange());
+            continue;
+        }
 
-    std::cout << ">> Decimal result: " << get_decimal_from_binary(encryptor, ctxt_result) << "\n";
+        // At a terminal, small enough trees take the whole feature vector as one ciphertext; piped queries keep one
+        // ciphertext per feature, so that the scheduler can pack them into lanes.
+        AsyncClient::Upload upload = interactive && coordinator == nullptr && !registry && !keys &&
+                                     model->supportsPackedFeatures()
+                                     ? AsyncClient::Upload::PACKED_FEATURES
+                                     : seeded_uploads ? AsyncClient::Upload::SEEDED : AsyncClient::Upload::PER_FEATURE;
+        pending.push_back(client.submit(inputs, upload, id));
+
+        while (!pending.empty() && (interactive || pending.size() >= MAX_PENDING ||
+                                    pending.front().wait_for(std::chrono::seconds(0)) == std::future_status::ready)) {
+            Client::print_result(pending.front());
+            pending.pop_front();
+        }
+    }
+    for (std::future<long> &result : pending) {
+        Client::print_result(result);
+    }
 }
 
 /**
- * Creates an input vector for the client and sends it to the server.
+ * The server side of a query: evaluates the encrypted inputs against {@code model}.
  * For demonstration purposes, currently this function only calls the server's method since they're both on the same
  * machine. However, this  method can be just as easily changed to pass the input vector over a network.
  *
- * @param encryptor an address of the encryptor object used to encrypt/decrypt a ciphertext.
- * @return The value that the server sent.
+ * @param context the context of the key the inputs are encrypted under.
+ * @param pubkey that key.
+ * @param model the model the server evaluates, encoded under that key.
+ * @param inputs the ciphertexts made by AsyncClient.
+ * @param upload how {@code inputs} were encrypted.
+ * @param rows the number of rows in the lanes of {@code inputs}.
+ * @param coordinator if not null, the server evaluates through these shard workers instead of in-process.
+ * @return The value that the server sent: the result of row r in lane r, and zero in every other lane.
  */
-helib::Ctxt Client::send_input_vector(COED::Encryptor &encryptor) {
-    helib::Context *context = encryptor.getContext();
-    helib::PubKey *pubKey = encryptor.getPublicKey();
-
-    int inputs[3];
-    std::cout << "Enter 3 feature vectors. Hit enter after each." << std::endl;
-    for (int &input : inputs) {
-        std::cin >> input;
-    }
-
+helib::Ctxt Client::send_input_vector(helib::Context &context, helib::PubKey &pubkey, const EncodedModel &model,
+                                      std::vector<helib::Ctxt> &inputs, AsyncClient::Upload upload, long rows,
+                                      ShardCoordinator *coordinator) {
     std::cout << "Calculating result..." << std::endl;
 
-    helib::Ctxt ctxt_input_vector[3] = {helib::Ctxt(*pubKey), helib::Ctxt(*pubKey), helib::Ctxt(*pubKey)};
-    TreeEvaluator::getCtxtList(*context, *pubKey, ctxt_input_vector, inputs);
-
-    helib::Ctxt ctxt_result = TreeEvaluator::evaluate_decision_tree(ctxt_input_vector, *(encryptor.getPublicKey()),
-                                                                    *encryptor.getContext());
+    helib::Ctxt result(pubkey);
+    if (upload == AsyncClient::Upload::PACKED_FEATURES) {
+        if (!model.supportsPackedFeatures())
+            throw std::runtime_error("the model was reloaded while the query was in flight");
+        result = TreeEvaluator::evaluate_packed_features(inputs.at(0), model, pubkey, context);
+    } else if ((int) inputs.size() != model.getTree().getFeatureCount()) {
+        throw std::runtime_error("the model was reloaded while the query was in flight");
+    } else if (coordinator != nullptr) {
+        result = coordinator->evaluate(inputs);
+    } else if (rows > 1) {
+        result = TreeEvaluator::evaluate_decision_tree(inputs.data(), model, pubkey, context);
+    } else {
+        result = TreeEvaluator::evaluate_single_query(inputs.data(), model, pubkey, context);
+    }
+    // The model is in every lane, so the lanes past the rows hold the tree evaluated on whatever sits there.
+    result.multByConstant(Lanes::mask(context, 0, rows));
+    return result;
+}
 
-    return ctxt_result;
+/**
+ * Waits for a result and prints it, or the error that prevented it.
+ * @param result a result from AsyncClient::submit.
+ */
+void Client::print_result(std::future<long> &result) {
+    try {
+        std::cout << ">> Decimal result: " << result.get() << "\n";
+    } catch (const std::exception &e) {
+        COED::Util::error(e.what());
+    }
 }
 
 /**
@@ -68,9 +272,25 @@ void Client::debugN(const COED::Encryptor &enc, const helib::Ctxt &ctxt, const s
 
 /**
  * Creates an encryptor object can be used to either encrypt or decrypt a plaintext.
+ * Keys left in /tmp by an earlier run are reused, so restarting the client does not regenerate them. The public key is
+ * also kept in binary form in /tmp/pk.bin, which is what worker processes should load.
  * @return the created object.
  */
 COED::Encryptor Client::createEncryptor() {
+    const std::string secret_key_file_path = "/tmp/sk.txt";
+    const std::string public_key_file_path = "/tmp/pk.txt";
+    const std::string binary_public_key_file_path = "/tmp/pk.bin";
+    struct stat st{};
+    if (stat(secret_key_file_path.c_str(), &st) == 0 && st.st_size > 0) {
+        COED::Util::info("Loading encryptor from " + secret_key_file_path + " ...");
+        COED::Encryptor encryptor(secret_key_file_path, public_key_file_path);
+        if (stat(binary_public_key_file_path.c_str(), &st) != 0) {
+            encryptor.writePublicKeyBinary(binary_public_key_file_path);
+        }
+        COED::Util::info("Finished loading encryptor.");
+        return encryptor;
+    }
+
     int plaintext_prime_modulus = 2;
     int phiM = 2665;
     int lifting = 1;
@@ -78,31 +298,13 @@ COED::Encryptor Client::createEncryptor() {
     int numOfColOfKeySwitchingMatrix = 2;
     COED::Util::info("Creating encryptor ...");
 
-    COED::Encryptor encryptor("/tmp/sk.txt", "/tmp/pk.txt",
+    COED::Encryptor encryptor(secret_key_file_path, public_key_file_path,
                               plaintext_prime_modulus,
                               phiM,
                               lifting,
                               numOfBitsOfModulusChain,
                               numOfColOfKeySwitchingMatrix);
+    encryptor.writePublicKeyBinary(binary_public_key_file_path);
     COED::Util::info("Finished creating encryptor.");
     return encryptor;
 }
-
-/**
- * Given a ciphertext representing some number in binary format, decrypts it and calculates the decimal result.
- * @param enc the encryptor object used to decrypt the ciphertext.
- * @param result The evaluation result sent by the server.
- * @return A decimal representation of the result.
- */
-double Client::get_decimal_from_binary(const COED::Encryptor &enc, const helib::Ctxt &result) {
-    std::vector<long> plaintext(enc.getEncryptedArray()->size());
-    enc.getEncryptedArray()->decrypt(result, *enc.getSecretKey(), plaintext);
-    double decimal_result = 0;
-
-    for (int i = 0; i < 16; ++i) {
-        double power = pow(2, 15 - i);
-        decimal_result += power * plaintext[i];
-    }
-    return decimal_result;
-
-}
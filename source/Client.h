@@ -6,19 +6,28 @@
 #ifndef HOMOMORPHICTREEEVALUATOR_CLIENT_H
 #define HOMOMORPHICTREEEVALUATOR_CLIENT_H
 
+#include "AsyncClient.h"
+#include "EncodedModel.h"
 #include "Encryptor.h"
 #include "Util.h"
 
+class ShardCoordinator;
+
 class Client {
 public:
-    static void main();
+    static void main(const std::string &model_path, const std::string &models_directory, int shards,
+                     double coalesce_ms = 0, bool seeded_uploads = false, const std::string &keys_directory = "",
+                     const std::string &client_id = "");
 
-private:
     static COED::Encryptor createEncryptor();
 
-    static helib::Ctxt send_input_vector(COED::Encryptor &encryptor);
+private:
+
+    static helib::Ctxt send_input_vector(helib::Context &context, helib::PubKey &pubkey, const EncodedModel &model,
+                                         std::vector<helib::Ctxt> &inputs, AsyncClient::Upload upload, long rows,
+                                         ShardCoordinator *coordinator);
 
-    static double get_decimal_from_binary(const COED::Encryptor &enc, const helib::Ctxt &result);
+    static void print_result(std::future<long> &result);
 
 public:
     static void debugN(const COED::Encryptor &enc, const helib::Ctxt &ctxt, const std::string &msg, int n);
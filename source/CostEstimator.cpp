@@ -0,0 +1,270 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#include "CostEstimator.h"
+
+#include <algorithm>
+#include <set>
+#include "LeafPolynomial.h"
+#include "TreeEvaluator.h"
+
+/**
+ * Accounts for the rounds of TreeEvaluator::rippleCompare from {@code round} on, given the depths of its two inputs.
+ * @return the depth of the comparison result.
+ */
+static int rippleCompare(CostEstimator::Report &report, int x_depth, int y_depth, int round) {
+    int sum_depth = std::max(x_depth, y_depth);
+    for (int i = round; i < BIT_SIZE; i++) {
+        sum_depth = std::max(x_depth, y_depth);
+        if (i == BIT_SIZE - 1)
+            break;
+        int carry_depth = std::max(x_depth, y_depth) + 1;
+        report.multiplications++;
+        report.rotations++;
+        report.constant_multiplications++;
+        x_depth = sum_depth;
+        y_depth = carry_depth;
+    }
+    // Lanes::bitMask, then Lanes::broadcastMsb.
+    report.constant_multiplications++;
+    for (int shift = 1; shift < BIT_SIZE; shift *= 2) {
+        report.rotations++;
+    }
+    return sum_depth;
+}
+
+/**
+ * Accounts for TreeEvaluator::compareThresholds against {@code count} thresholds.
+ * @return the depth of the decisions.
+ */
+static int compareThresholds(CostEstimator::Report &report, long count, long lanes) {
+    int depth = 0;
+    for (long first = 0; first < count; first += lanes) {
+        long chunk = std::min(lanes, count - first);
+        // Lanes::replicate
+        for (long width = 1; width < chunk; width += std::min(width, chunk - width)) {
+            if (chunk - width < width)
+                report.constant_multiplications++;
+            report.rotations++;
+        }
+        // The first round against the plaintext thresholds.
+        report.constant_multiplications += 2;
+        report.rotations++;
+        depth = std::max(depth, rippleCompare(report, 0, 0, 1));
+        report.rotations += chunk - 1;
+        report.comparisons += chunk;
+    }
+    return depth;
+}
+
+/**
+ * Accounts for TreeEvaluator::prefixProducts.
+ * @return the depth it adds.
+ */
+static int prefixProducts(CostEstimator::Report &report) {
+    int depth = 0;
+    for (int shift = 1; shift < BIT_SIZE; shift *= 2) {
+        report.rotations++;
+        report.constant_multiplications++;
+        report.multiplications++;
+        depth++;
+    }
+    return depth;
+}
+
+/**
+ * Accounts for the range and equality tests of TreeEvaluator::compareRange and compareEqual.
+ * @return the depth of the decision.
+ */
+static int compareLanes(CostEstimator::Report &report, DecisionTree::Test test) {
+    int depth = 0;
+    // lessThanTerms, once per bound of a range.
+    for (int bound = 0; bound < (test == DecisionTree::Test::RANGE ? 2 : 1); bound++) {
+        depth = prefixProducts(report);
+        report.rotations++;
+        report.constant_multiplications++;
+        if (test == DecisionTree::Test::RANGE) {
+            report.constant_multiplications++;
+            report.multiplications++;
+            depth++;
+        }
+    }
+    // sumLanes adds up the lane and masks its MSB first.
+    if (test == DecisionTree::Test::RANGE) {
+        for (int shift = 1; shift < BIT_SIZE; shift *= 2) {
+            report.rotations++;
+        }
+        report.constant_multiplications++;
+    }
+    // Lanes::broadcastMsb
+    for (int shift = 1; shift < BIT_SIZE; shift *= 2) {
+        report.rotations++;
+    }
+    return depth;
+}
+
+/**
+ * Accounts for one node evaluated on its own, in the layout of evaluate_decision_tree.
+ * @return the depth of the decision.
+ */
+static int compareNode(CostEstimator::Report &report, const DecisionTree::Node &node) {
+    if (node.test == DecisionTree::Test::LESS_THAN)
+        return rippleCompare(report, 0, 0, 0);
+    return compareLanes(report, node.test);
+}
+
+/**
+ * Accounts for BitSlices::lessThan against {@code threshold}.
+ * @return the depth of the decision.
+ */
+static int bitSlicedLessThan(CostEstimator::Report &report, int threshold) {
+    int y[BIT_SIZE];
+    getBin(-threshold, y);
+    int carry_depth = -1;
+    for (int j = BIT_SIZE - 1; j > 0; j--) {
+        if (carry_depth >= 0) {
+            report.multiplications++;
+            carry_depth++;
+        } else if (y[j] == 1) {
+            carry_depth = 0;
+        }
+    }
+    return std::max(carry_depth, 0);
+}
+
+/**
+ * Accounts for the test of one node in BitSlices::evaluate.
+ * @return the depth of the decision.
+ */
+static int bitSlicedNode(CostEstimator::Report &report, const DecisionTree::Node &node) {
+    if (node.test == DecisionTree::Test::EQUAL) {
+        report.multiplications += BIT_SIZE - 1;
+        int depth = 0;
+        for (int width = 1; width < BIT_SIZE; width *= 2) {
+            depth++;
+        }
+        return depth;
+    }
+    int depth = bitSlicedLessThan(report, node.threshold);
+    if (node.test == DecisionTree::Test::RANGE)
+        depth = std::max(depth, bitSlicedLessThan(report, node.upper));
+    return depth;
+}
+
+/**
+ * Walks the evaluation of {@code tree} in the given layout.
+ * @param tree the model.
+ * @param parameters the encryption parameters and per-operation costs.
+ * @param layout how the query is uploaded and evaluated.
+ * @return the predicted cost.
+ */
+CostEstimator::Report
+CostEstimator::estimate(const DecisionTree &tree, const Parameters &parameters, Layout layout) {
+    Report report;
+    report.slots = CostEstimator::slotCount(parameters.m, parameters.p);
+    long lanes = report.slots / BIT_SIZE;
+
+    if (layout == Layout::PER_FEATURE) {
+        for (int i = 0; i < tree.getNodeCount(); i++) {
+            report.comparison_depth = std::max(report.comparison_depth, compareNode(report, tree.getNode(i)));
+            report.comparisons++;
+        }
+    } else if (layout == Layout::SINGLE_QUERY) {
+        std::vector<long> nodes_per_feature(tree.getFeatureCount(), 0);
+        for (int i = 0; i < tree.getNodeCount(); i++) {
+            const DecisionTree::Node &node = tree.getNode(i);
+            if (node.test == DecisionTree::Test::LESS_THAN) {
+                nodes_per_feature[node.feature]++;
+            } else {
+                report.comparison_depth = std::max(report.comparison_depth, compareNode(report, node));
+                report.comparisons++;
+            }
+        }
+        for (long count : nodes_per_feature) {
+            if (count > 0)
+                report.comparison_depth = std::max(report.comparison_depth, compareThresholds(report, count, lanes));
+        }
+    } else if (layout == Layout::BIT_SLICED) {
+        for (int i = 0; i < tree.getNodeCount(); i++) {
+            report.comparison_depth = std::max(report.comparison_depth, bitSlicedNode(report, tree.getNode(i)));
+            report.comparisons++;
+        }
+    } else {
+        report.layout_supported = tree.getNodeCount() <= lanes && tree.getFeatureCount() <= lanes;
+        std::set<long> shifts;
+        for (int i = 0; i < tree.getNodeCount(); i++) {
+            shifts.insert(i - tree.getNode(i).feature);
+            if (tree.getNode(i).test != DecisionTree::Test::LESS_THAN)
+                report.layout_supported = false;
+        }
+        report.constant_multiplications += shifts.size();
+        report.rotations += shifts.size() - shifts.count(0);
+        report.comparison_depth = rippleCompare(report, 0, 0, 0);
+        report.rotations += tree.getNodeCount() - 1;
+        report.comparisons = tree.getNodeCount();
+    }
+
+    // The bit-sliced layout multiplies path indicators only; the leaf values are added in the clear.
+    LeafPolynomial polynomial = LeafPolynomial::compile(tree, layout != Layout::BIT_SLICED);
+    report.multiplications += polynomial.getMultiplications();
+    report.leaf_polynomial_depth = polynomial.getDepth();
+    report.depth = report.comparison_depth + report.leaf_polynomial_depth;
+
+    report.required_modulus_bits = parameters.base_bits + report.depth * parameters.bits_per_level;
+    report.fits = report.layout_supported && report.required_modulus_bits <= parameters.numOfBitsOfModulusChain;
+
+    double scale = CostEstimator::phi(parameters.m) / 1920.0 * parameters.numOfBitsOfModulusChain / 512.0;
+    report.estimated_ms = scale * (report.multiplications * parameters.ms_per_multiplication +
+                                   report.rotations * parameters.ms_per_rotation +
+                                   report.constant_multiplications * parameters.ms_per_constant_multiplication);
+    return report;
+}
+
+void CostEstimator::print(const Report &report, const Parameters &parameters, std::ostream &out) {
+    out << "Comparisons:              " << report.comparisons << "\n"
+        << "Multiplicative depth:     " << report.depth << " (comparisons " << report.comparison_depth
+        << ", leaf polynomial " << report.leaf_polynomial_depth << ")\n"
+        << "Multiplications:          " << report.multiplications << "\n"
+        << "Rotations:                " << report.rotations << "\n"
+        << "Constant multiplications: " << report.constant_multiplications << "\n"
+        << "Slots (lanes):            " << report.slots << " (" << report.slots / BIT_SIZE << ")\n"
+        << "Required modulus bits:    " << report.required_modulus_bits << " of "
+        << parameters.numOfBitsOfModulusChain << "\n"
+        << "Estimated latency:        " << report.estimated_ms << " ms\n"
+        << "Fits:                     " << (report.fits ? "yes" : "no")
+        << (report.layout_supported ? "" : " (this layout cannot evaluate the tree)") << std::endl;
+}
+
+/**
+ * @return Euler's totient of {@code m}.
+ */
+long CostEstimator::phi(long m) {
+    long result = m;
+    for (long factor = 2; factor * factor <= m; factor++) {
+        if (m % factor == 0) {
+            while (m % factor == 0) {
+                m /= factor;
+            }
+            result -= result / factor;
+        }
+    }
+    if (m > 1)
+        result -= result / m;
+    return result;
+}
+
+/**
+ * @return the number of plaintext slots for cyclotomic index {@code m} and plaintext prime {@code p}, phi(m) divided by
+ * the order of p modulo m.
+ */
+long CostEstimator::slotCount(long m, long p) {
+    long order = 1;
+    long power = p % m;
+    while (power != 1) {
+        power = power * p % m;
+        order++;
+    }
+    return CostEstimator::phi(m) / order;
+}
@@ -0,0 +1,73 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#ifndef HOMOMORPHICTREEEVALUATOR_COSTESTIMATOR_H
+#define HOMOMORPHICTREEEVALUATOR_COSTESTIMATOR_H
+
+#include <iostream>
+#include "DecisionTree.h"
+
+/**
+ * Dry run of an evaluation: walks the same circuit as compareCtxt, compareThresholds and the compiled leaf polynomial
+ * on plaintext bookkeeping only, and reports its depth, operation counts, the modulus chain it needs and an estimated
+ * latency. Nothing is encrypted and no keys are needed, so a model can be checked against a parameter set in
+ * milliseconds.
+ */
+class CostEstimator {
+public:
+    /**
+     * The encryption parameters, by default those of Client::createEncryptor, and the per-operation costs used to turn
+     * operation counts into bits and milliseconds.
+     */
+    struct Parameters {
+        long m = 2665;
+        long p = 2;
+        long numOfBitsOfModulusChain = 512;
+        // Bits of the chain needed for a fresh ciphertext to still decrypt, and bits consumed per multiplication level.
+        double base_bits = 60;
+        double bits_per_level = 24;
+        // Latencies at phi(m) = 1920 (m = 2665) and a 512-bit chain; scaled linearly in phi(m) and in the chain length.
+        double ms_per_multiplication = 25;
+        double ms_per_rotation = 20;
+        double ms_per_constant_multiplication = 1;
+    };
+
+    /**
+     * How the query reaches the server: one ciphertext per feature evaluated by evaluate_decision_tree, the same
+     * evaluated by evaluate_single_query, a single packed ciphertext evaluated by evaluate_packed_features, or
+     * BIT_SIZE ciphertexts per feature evaluated by BitSlices::evaluate. The last reports the cost of a whole batch of
+     * one query per slot.
+     */
+    enum class Layout {
+        PER_FEATURE, SINGLE_QUERY, PACKED_FEATURES, BIT_SLICED
+    };
+
+    struct Report {
+        int comparisons = 0;
+        int comparison_depth = 0;
+        int leaf_polynomial_depth = 0;
+        int depth = 0;
+        long multiplications = 0;
+        long rotations = 0;
+        long constant_multiplications = 0;
+        long slots = 0;
+        // False if the tree does not fit the lanes the layout needs, or tests what the layout cannot.
+        bool layout_supported = true;
+        double required_modulus_bits = 0;
+        double estimated_ms = 0;
+        bool fits = false;
+    };
+
+    static Report estimate(const DecisionTree &tree, const Parameters &parameters, Layout layout);
+
+    static void print(const Report &report, const Parameters &parameters, std::ostream &out);
+
+    static long phi(long m);
+
+    static long slotCount(long m, long p);
+};
+
+
+#endif //HOMOMORPHICTREEEVALUATOR_COSTESTIMATOR_H
@@ -0,0 +1,202 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#include "CtxtFile.h"
+
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include "Util.h"
+
+static const char HEADER_MAGIC[] = "COEDCTXT";
+static const char INDEX_MAGIC[] = "COEDINDX";
+static const uint64_t FORMAT_VERSION = 1;
+static const size_t MAGIC_BYTES = 8;
+static const size_t HEADER_BYTES = MAGIC_BYTES + 2 * sizeof(uint64_t);
+// Record count, index offset and magic.
+static const size_t FOOTER_BYTES = 2 * sizeof(uint64_t) + MAGIC_BYTES;
+
+static void put(std::string &bytes, uint64_t value) {
+    bytes.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static uint64_t get(const char *bytes) {
+    uint64_t value;
+    std::memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+/**
+ * Creates {@code path}, replacing any file there, and writes the header.
+ * @param path the file to write.
+ * @param context the context of every record.
+ * @param chunk_bytes records are buffered and written once at least this many bytes are pending.
+ */
+COED::CtxtFileWriter::CtxtFileWriter(const std::string &path, const helib::Context &context, size_t chunk_bytes)
+        : out(path, std::ios::binary | std::ios::trunc), chunk_bytes(chunk_bytes), chunk_offset(HEADER_BYTES) {
+    if (!out.is_open())
+        throw std::runtime_error("cannot create " + path);
+    std::string header(HEADER_MAGIC, MAGIC_BYTES);
+    put(header, FORMAT_VERSION);
+    put(header, CtxtFileWriter::fingerprint(context));
+    out.write(header.data(), header.size());
+}
+
+COED::CtxtFileWriter::~CtxtFileWriter() {
+    try {
+        close();
+    } catch (const std::exception &e) {
+        COED::Util::error(e.what());
+    }
+}
+
+/**
+ * Adds a record. It reaches the file with its chunk, or on flush or close.
+ * @param ctxt a ciphertext of the writer's context.
+ */
+void COED::CtxtFileWriter::append(const helib::Ctxt &ctxt) {
+    std::ostringstream record;
+    ctxt.write(record);
+    const std::string &bytes = record.str();
+
+    offsets.push_back(chunk_offset + chunk.size());
+    put(chunk, bytes.size());
+    chunk.append(bytes);
+    if (chunk.size() >= chunk_bytes) {
+        flush();
+    }
+}
+
+/**
+ * Writes the pending chunk. Records written so far survive a crash, though the file then has no index.
+ */
+void COED::CtxtFileWriter::flush() {
+    out.write(chunk.data(), chunk.size());
+    out.flush();
+    if (!out)
+        throw std::runtime_error("cannot write ciphertext file");
+    chunk_offset += chunk.size();
+    chunk.clear();
+}
+
+/**
+ * Writes the pending chunk and the index. Appending after close is an error.
+ */
+void COED::CtxtFileWriter::close() {
+    if (closed)
+        return;
+    closed = true;
+    // A zero length ends the records, so that a reader scanning a file whose index was cut off stops there.
+    put(chunk, 0);
+    flush();
+
+    std::string index;
+    for (uint64_t offset : offsets) {
+        put(index, offset);
+    }
+    put(index, offsets.size());
+    put(index, chunk_offset);
+    index.append(INDEX_MAGIC, MAGIC_BYTES);
+    out.write(index.data(), index.size());
+    out.close();
+    if (!out)
+        throw std::runtime_error("cannot write ciphertext file index");
+}
+
+size_t COED::CtxtFileWriter::size() const {
+    return offsets.size();
+}
+
+/**
+ * A 64-bit FNV-1a hash of the binary serialization of {@code context}, which covers its parameters and modulus chain.
+ * Files written under one context cannot be read under another.
+ * @param context the context to identify.
+ * @return the fingerprint.
+ */
+uint64_t COED::CtxtFileWriter::fingerprint(const helib::Context &context) {
+    std::ostringstream serialized;
+    helib::writeContextBaseBinary(serialized, context);
+    helib::writeContextBinary(serialized, context);
+
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char byte : serialized.str()) {
+        hash = (hash ^ byte) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * Maps {@code path} and loads its index, or rebuilds it by scanning the records if the file has none.
+ * @param path the file to read.
+ * @param pubkey the public key records are read under; its context must be the one the file was written with.
+ */
+COED::CtxtFileReader::CtxtFileReader(const std::string &path, const helib::PubKey &pubkey)
+        : file(path), pubkey(pubkey) {
+    const char *data = file.data();
+    size_t size = file.size();
+    if (size < HEADER_BYTES || std::memcmp(data, HEADER_MAGIC, MAGIC_BYTES) != 0)
+        throw std::runtime_error(path + " is not a ciphertext file");
+    if (get(data + MAGIC_BYTES) != FORMAT_VERSION)
+        throw std::runtime_error(path + " has an unsupported format version");
+    if (get(data + MAGIC_BYTES + sizeof(uint64_t)) != CtxtFileWriter::fingerprint(pubkey.getContext()))
+        throw std::runtime_error(path + " was written under a different context");
+
+    if (size >= HEADER_BYTES + FOOTER_BYTES &&
+        std::memcmp(data + size - MAGIC_BYTES, INDEX_MAGIC, MAGIC_BYTES) == 0) {
+        uint64_t count = get(data + size - FOOTER_BYTES);
+        uint64_t index_offset = get(data + size - FOOTER_BYTES + sizeof(uint64_t));
+        // Checked without overflow: the index must fit between the header and the footer, and end at the footer.
+        if (count > (size - HEADER_BYTES - FOOTER_BYTES) / sizeof(uint64_t) ||
+            index_offset != size - FOOTER_BYTES - sizeof(uint64_t) * count)
+            throw std::runtime_error(path + " has a corrupt index");
+        const char *index = data + index_offset;
+        for (uint64_t i = 0; i < count; i++) {
+            uint64_t offset = get(index + i * sizeof(uint64_t));
+            // Every record, its length included, must lie between the header and the index.
+            if (offset < HEADER_BYTES || offset > index_offset - sizeof(uint64_t) ||
+                get(data + offset) > index_offset - offset - sizeof(uint64_t))
+                throw std::runtime_error(path + " has a corrupt index entry for record " + std::to_string(i));
+            offsets.push_back(offset);
+        }
+        complete = true;
+        return;
+    }
+
+    COED::Util::info(path + " has no index, scanning its records");
+    size_t offset = HEADER_BYTES;
+    while (offset + sizeof(uint64_t) <= size) {
+        uint64_t length = get(data + offset);
+        if (length == 0 || length > size - offset - sizeof(uint64_t))
+            break;
+        offsets.push_back(offset);
+        offset += sizeof(uint64_t) + length;
+    }
+}
+
+size_t COED::CtxtFileReader::size() const {
+    return offsets.size();
+}
+
+/**
+ * @return whether the file was closed by its writer, as opposed to holding what was flushed before it stopped.
+ */
+bool COED::CtxtFileReader::isComplete() const {
+    return complete;
+}
+
+/**
+ * Parses one record straight from the mapping. Safe to call from several threads at once.
+ * @param record the index of the record, in the order it was appended.
+ * @return the ciphertext.
+ */
+helib::Ctxt COED::CtxtFileReader::read(size_t record) const {
+    uint64_t offset = offsets.at(record);
+    COED::MappedFile::Stream in(file.data() + offset + sizeof(uint64_t), get(file.data() + offset));
+    helib::Ctxt ctxt(pubkey);
+    ctxt.read(in);
+    if (!in)
+        throw std::runtime_error("corrupt ciphertext record " + std::to_string(record));
+    return ctxt;
+}
@@ -0,0 +1,75 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#ifndef HOMOMORPHICTREEEVALUATOR_CTXTFILE_H
+#define HOMOMORPHICTREEEVALUATOR_CTXTFILE_H
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <helib/helib.h>
+#include "MappedFile.h"
+
+/*
+ * A file of helib::Ctxt records in HElib's binary format, for bulk queries and results. All integers are 64-bit in host
+ * byte order:
+ *      header: "COEDCTXT", format version, context fingerprint
+ *      records: byte length, Ctxt::write output; written in chunks
+ *      index: the offset of every record, the record count, the offset of the index, "COEDINDX"
+ * The index is written by CtxtFileWriter::close. A file without one (its writer did not finish) is still readable up
+ * to its last complete record.
+ */
+namespace COED {
+    class CtxtFileWriter {
+    public:
+        CtxtFileWriter(const std::string &path, const helib::Context &context, size_t chunk_bytes = 4 << 20);
+
+        CtxtFileWriter(const CtxtFileWriter &) = delete;
+
+        CtxtFileWriter &operator=(const CtxtFileWriter &) = delete;
+
+        ~CtxtFileWriter();
+
+        void append(const helib::Ctxt &ctxt);
+
+        void flush();
+
+        void close();
+
+        size_t size() const;
+
+        static uint64_t fingerprint(const helib::Context &context);
+
+    private:
+        std::ofstream out;
+        size_t chunk_bytes;
+        std::string chunk;
+        // Where the chunk will start in the file.
+        uint64_t chunk_offset;
+        std::vector<uint64_t> offsets;
+        bool closed = false;
+    };
+
+    class CtxtFileReader {
+    public:
+        CtxtFileReader(const std::string &path, const helib::PubKey &pubkey);
+
+        size_t size() const;
+
+        bool isComplete() const;
+
+        helib::Ctxt read(size_t record) const;
+
+    private:
+        MappedFile file;
+        const helib::PubKey &pubkey;
+        std::vector<uint64_t> offsets;
+        bool complete = false;
+    };
+}
+
+#endif //HOMOMORPHICTREEEVALUATOR_CTXTFILE_H
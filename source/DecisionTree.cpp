@@ -0,0 +1,446 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#include "DecisionTree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include "FileSystem.h"
+#include "TreeEvaluator.h"
+
+/**
+ * Parses a child reference of the form n<id> or l<id>.
+ * @param token the token read from the model file.
+ * @param line_number the line the token was read from, used for error messages.
+ * @return the parsed child.
+ */
+static DecisionTree::Child parseChild(const std::string &token, int line_number) {
+    if (token.size() < 2 || (token[0] != 'n' && token[0] != 'l')) {
+        throw std::runtime_error("line " + std::to_string(line_number) + ": bad child reference '" + token + "'");
+    }
+    size_t end = 0;
+    int index = -1;
+    try {
+        index = std::stoi(token.substr(1), &end);
+    } catch (const std::logic_error &) {
+        // Reported below, with the line.
+    }
+    if (end != token.size() - 1) {
+        throw std::runtime_error("line " + std::to_string(line_number) + ": bad child reference '" + token + "'");
+    }
+    return {token[0] == 'l', index};
+}
+
+/**
+ * @param value a threshold or bound.
+ * @return {@code value} as written in a model file, e.g. "25" or "24.5".
+ */
+static std::string formatValue(double value) {
+    std::ostringstream out;
+    out << value;
+    return out.str();
+}
+
+/**
+ * Reads a model file. See DecisionTree.h for the format.
+ * @param path the path of the model file.
+ * @return the parsed and validated tree.
+ */
+DecisionTree DecisionTree::load(const std::string &path) {
+    COED::FileSystem fs(path);
+    fs.open_input_stream();
+    std::ifstream &in = fs.get_input_stream();
+    if (!in.is_open()) {
+        throw std::runtime_error("cannot open model file " + path);
+    }
+
+    DecisionTree tree;
+    std::map<int, Node> nodes;
+    std::map<int, int> leaves;
+    // Integral features, and the line that declared them.
+    std::map<int, int> integral;
+    std::string line;
+    int line_number = 0;
+    while (std::getline(in, line)) {
+        line_number++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream statement(line);
+        std::string keyword;
+        if (!(statement >> keyword)) {
+            continue;
+        }
+
+        if (keyword == "features") {
+            statement >> tree.feature_count;
+        } else if (keyword == "integer") {
+            int feature;
+            while (statement >> feature) {
+                integral.emplace(feature, line_number);
+            }
+            if (!statement.eof()) {
+                throw std::runtime_error("line " + std::to_string(line_number) + ": malformed 'integer'");
+            }
+            continue;
+        } else if (keyword == "node" || keyword == "range" || keyword == "equal") {
+            int id;
+            Node node{};
+            std::string true_child, false_child;
+            statement >> id >> node.feature >> node.real_threshold;
+            if (keyword == "range") {
+                node.test = Test::RANGE;
+                statement >> node.real_upper;
+            } else if (keyword == "equal") {
+                node.test = Test::EQUAL;
+                if (node.real_threshold != std::floor(node.real_threshold)) {
+                    throw std::runtime_error("line " + std::to_string(line_number) + ": equality value " +
+                                             formatValue(node.real_threshold) + " is not an integer");
+                }
+            }
+            // Out of range values are rejected by validate; clamping keeps them out of range without overflowing.
+            node.threshold = (int) std::max(-1e9, std::min(1e9, std::ceil(node.real_threshold)));
+            node.upper = (int) std::max(-1e9, std::min(1e9, std::ceil(node.real_upper)));
+            statement >> true_child >> false_child;
+            node.true_child = parseChild(true_child, line_number);
+            node.false_child = parseChild(false_child, line_number);
+            if (!nodes.emplace(id, node).second) {
+                throw std::runtime_error("line " + std::to_string(line_number) + ": node " + std::to_string(id) +
+                                         " is defined twice");
+            }
+        } else if (keyword == "leaf") {
+            int id, value;
+            statement >> id >> value;
+            if (!leaves.emplace(id, value).second) {
+                throw std::runtime_error("line " + std::to_string(line_number) + ": leaf " + std::to_string(id) +
+                                         " is defined twice");
+            }
+        } else {
+            throw std::runtime_error("line " + std::to_string(line_number) + ": unknown statement '" + keyword + "'");
+        }
+        if (statement.fail()) {
+            throw std::runtime_error("line " + std::to_string(line_number) + ": malformed '" + keyword + "'");
+        }
+    }
+    fs.close_input_stream();
+
+    tree.integral.assign(std::max(tree.feature_count, 0), false);
+    for (auto &entry : integral) {
+        if (entry.first < 0 || entry.first >= tree.feature_count) {
+            throw std::runtime_error("line " + std::to_string(entry.second) + ": feature " +
+                                     std::to_string(entry.first) + " is out of range");
+        }
+        tree.integral[entry.first] = true;
+    }
+
+    for (auto &entry : nodes) {
+        if (entry.first != (int) tree.nodes.size()) {
+            throw std::runtime_error("node ids must be numbered 0.." + std::to_string(nodes.size() - 1));
+        }
+        tree.nodes.push_back(entry.second);
+    }
+    for (auto &entry : leaves) {
+        if (entry.first != (int) tree.leaves.size()) {
+            throw std::runtime_error("leaf ids must be numbered 0.." + std::to_string(leaves.size() - 1));
+        }
+        tree.leaves.push_back(entry.second);
+    }
+    tree.validate();
+    return tree;
+}
+
+/**
+ * The tree from README.md. Node 2 is a dummy node (feature 2 < 999 always holds) whose false branch leads to a
+ * zero-valued leaf, so this tree evaluates to exactly the same polynomial as TreeEvaluator::calculate_result.
+ * @return the default tree.
+ */
+DecisionTree DecisionTree::default_tree() {
+    DecisionTree tree;
+    tree.feature_count = 3;
+    tree.nodes = {
+            {0, 27,  {false, 2}, {false, 1}},
+            {1, 17,  {true, 1},  {true, 2}},
+            {2, 999, {true, 0},  {true, 3}},
+    };
+    tree.leaves = {10, 20, 30, 0};
+    tree.markIntegral();
+    tree.validate();
+    return tree;
+}
+
+/**
+ * Generates a random tree for load tests: a chain of {@code depth} nodes along the true branches, with the remaining
+ * nodes hung off random free branches no deeper than {@code depth}. Feature values around 0 to 1000 take both sides of
+ * most thresholds, and every leaf is non-zero so that no leaf term is optimised away.
+ * @param depth the number of decision nodes on the longest root-to-leaf path.
+ * @param node_count the number of decision nodes, between {@code depth} and 2^depth - 1.
+ * @param feature_count the number of features the nodes test.
+ * @param seed the seed of the generator; equal arguments give equal trees.
+ * @return the generated tree.
+ */
+DecisionTree DecisionTree::synthetic(int depth, int node_count, int feature_count, unsigned seed) {
+    if (depth < 1 || node_count < depth || (depth < 31 && node_count > (1 << depth) - 1) || feature_count < 1) {
+        throw std::invalid_argument("no tree of depth " + std::to_string(depth) + " has " +
+                                    std::to_string(node_count) + " nodes");
+    }
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<int> features(0, feature_count - 1);
+    std::uniform_int_distribution<int> thresholds(1, 999);
+    std::uniform_int_distribution<int> values(1, 1000);
+
+    DecisionTree tree;
+    tree.feature_count = feature_count;
+    // A branch without a child yet, and the depth a node placed there would have.
+    struct Slot {
+        int node;
+        bool branch;
+        int depth;
+    };
+    std::vector<Slot> open;
+    auto add = [&](int node_depth) {
+        int id = tree.nodes.size();
+        tree.nodes.push_back({features(random), thresholds(random), {true, 0}, {true, 0}});
+        open.push_back({id, true, node_depth + 1});
+        open.push_back({id, false, node_depth + 1});
+        return id;
+    };
+    auto attach = [&](const Slot &slot, const Child &child) {
+        Node &node = tree.nodes[slot.node];
+        (slot.branch ? node.true_child : node.false_child) = child;
+    };
+
+    add(1);
+    while ((int) tree.nodes.size() < depth) {
+        // The true branch of the node added last.
+        Slot slot = open[open.size() - 2];
+        open.erase(open.end() - 2);
+        attach(slot, {false, add(slot.depth)});
+    }
+    while ((int) tree.nodes.size() < node_count) {
+        std::vector<size_t> candidates;
+        for (size_t i = 0; i < open.size(); i++) {
+            if (open[i].depth <= depth) {
+                candidates.push_back(i);
+            }
+        }
+        size_t pick = candidates[std::uniform_int_distribution<size_t>(0, candidates.size() - 1)(random)];
+        Slot slot = open[pick];
+        open.erase(open.begin() + pick);
+        attach(slot, {false, add(slot.depth)});
+    }
+    for (const Slot &slot : open) {
+        attach(slot, {true, (int) tree.leaves.size()});
+        tree.leaves.push_back(values(random));
+    }
+    tree.markIntegral();
+    tree.validate();
+    return tree;
+}
+
+/**
+ * compareCtxt and BitSlices::lessThan decide x < t from the sign of x - t in BIT_SIZE bits, which wraps once |x - t|
+ * reaches 2^(BIT_SIZE - 1): in 16 bits, 20000 < -20000 would hold. Features, thresholds and bounds are therefore kept to
+ * signed BIT_SIZE - 1 bits, so that the difference of any two fits a lane.
+ * @param value a feature, threshold, bound or equality value.
+ * @return whether {@code value} lies in laneRange().
+ */
+bool DecisionTree::fitsLane(long value) {
+    return -(1L << (BIT_SIZE - 2)) <= value && value < (1L << (BIT_SIZE - 2));
+}
+
+/**
+ * @return the values fitsLane accepts, for error messages, e.g. "[-16384, 16384)".
+ */
+std::string DecisionTree::laneRange() {
+    return "[" + std::to_string(-(1L << (BIT_SIZE - 2))) + ", " + std::to_string(1L << (BIT_SIZE - 2)) + ")";
+}
+
+/**
+ * @param value a leaf value.
+ * @return whether {@code value} is an unsigned BIT_SIZE-bit integer, the values a client decodes from a result lane
+ * (see AsyncClient::decode).
+ */
+bool DecisionTree::fitsResult(long value) {
+    return 0 <= value && value < (1L << BIT_SIZE);
+}
+
+/**
+ * Checks that every reference points at an existing node, leaf or feature, that every threshold, bound and value
+ * fits a lane, that every leaf value fits a result, and that the nodes form a single tree rooted at node 0 (every
+ * node other than the root has exactly one parent).
+ */
+void DecisionTree::validate() const {
+    if (nodes.empty() || leaves.empty()) {
+        throw std::runtime_error("a model needs at least one node and one leaf");
+    }
+    for (int value : leaves) {
+        if (!fitsResult(value)) {
+            throw std::runtime_error("leaf value " + std::to_string(value) + " is outside [0, " +
+                                     std::to_string(1L << BIT_SIZE) + ")");
+        }
+    }
+    std::vector<int> parents(nodes.size(), 0);
+    for (const Node &node : nodes) {
+        if (node.feature < 0 || node.feature >= feature_count) {
+            throw std::runtime_error("node feature " + std::to_string(node.feature) + " is out of range");
+        }
+        if (!fitsLane(node.threshold) || (node.test == Test::RANGE && !fitsLane(node.upper))) {
+            throw std::runtime_error("node threshold " + formatValue(node.real_threshold) +
+                                     (node.test == Test::RANGE ? " to " + formatValue(node.real_upper) : "") +
+                                     " is outside " + laneRange());
+        }
+        if (node.test == Test::RANGE && node.real_threshold >= node.real_upper) {
+            throw std::runtime_error("range " + formatValue(node.real_threshold) + " to " +
+                                     formatValue(node.real_upper) + " is empty");
+        }
+        for (const Child &child : {node.true_child, node.false_child}) {
+            int limit = child.is_leaf ? (int) leaves.size() : (int) nodes.size();
+            if (child.index < 0 || child.index >= limit) {
+                throw std::runtime_error("child reference " + std::to_string(child.index) + " is out of range");
+            }
+            if (!child.is_leaf) {
+                parents[child.index]++;
+            }
+        }
+    }
+    if (parents[0] != 0 || std::any_of(parents.begin() + 1, parents.end(), [](int p) { return p != 1; })) {
+        throw std::runtime_error("nodes do not form a tree rooted at node 0");
+    }
+}
+
+/**
+ * Declares every feature integral and takes the real thresholds from the integer ones, for trees built in code.
+ */
+void DecisionTree::markIntegral() {
+    integral.assign(feature_count, true);
+    for (Node &node : nodes) {
+        node.real_threshold = node.threshold;
+        node.real_upper = node.upper;
+    }
+}
+
+int DecisionTree::getFeatureCount() const {
+    return feature_count;
+}
+
+int DecisionTree::getNodeCount() const {
+    return nodes.size();
+}
+
+int DecisionTree::getLeafCount() const {
+    return leaves.size();
+}
+
+const DecisionTree::Node &DecisionTree::getNode(int i) const {
+    return nodes.at(i);
+}
+
+int DecisionTree::getLeafValue(int i) const {
+    return leaves.at(i);
+}
+
+/**
+ * @param feature a feature.
+ * @return whether the model declares the feature integral, i.e. never holding a fraction. Trees built in code have
+ * integral features only.
+ */
+bool DecisionTree::isIntegral(int feature) const {
+    return integral.at(feature);
+}
+
+/**
+ * Evaluates the tree in the clear, e.g. to check an encrypted result.
+ * @param features one value per feature.
+ * @return the value of the leaf reached.
+ */
+int DecisionTree::classify(const std::vector<int> &features) const {
+    Child child{false, 0};
+    while (!child.is_leaf) {
+        const Node &node = nodes[child.index];
+        child = node.holds(features.at(node.feature)) ? node.true_child : node.false_child;
+    }
+    return leaves[child.index];
+}
+
+/**
+ * Evaluates the tree in the clear on real-valued features, against the thresholds as written in the model.
+ * @param features one value per feature.
+ * @return the value of the leaf reached.
+ */
+int DecisionTree::classify(const std::vector<double> &features) const {
+    Child child{false, 0};
+    while (!child.is_leaf) {
+        const Node &node = nodes[child.index];
+        child = node.holds(features.at(node.feature)) ? node.true_child : node.false_child;
+    }
+    return leaves[child.index];
+}
+
+/**
+ * @param value the value of the node's feature.
+ * @return whether the node's test holds for {@code value}.
+ */
+bool DecisionTree::Node::holds(int value) const {
+    switch (test) {
+        case Test::RANGE:
+            return threshold <= value && value < upper;
+        case Test::EQUAL:
+            return value == threshold;
+        default:
+            return value < threshold;
+    }
+}
+
+/**
+ * @param value the real value of the node's feature.
+ * @return whether the node's test holds for {@code value}, against the thresholds as written in the model.
+ */
+bool DecisionTree::Node::holds(double value) const {
+    switch (test) {
+        case Test::RANGE:
+            return real_threshold <= value && value < real_upper;
+        case Test::EQUAL:
+            return value == real_threshold;
+        default:
+            return value < real_threshold;
+    }
+}
+
+/**
+ * Enumerates every root-to-leaf path. A leaf reachable along several paths appears once per path.
+ * @return the paths, in depth-first order with the true branch first.
+ */
+std::vector<DecisionTree::Path> DecisionTree::paths() const {
+    std::vector<Path> result;
+    std::vector<std::pair<int, bool>> steps;
+    std::function<void(const Child &)> walk = [&](const Child &child) {
+        if (child.is_leaf) {
+            result.push_back({child.index, steps});
+            return;
+        }
+        const Node &node = nodes[child.index];
+        steps.emplace_back(child.index, true);
+        walk(node.true_child);
+        steps.back().second = false;
+        walk(node.false_child);
+        steps.pop_back();
+    };
+    walk({false, 0});
+    return result;
+}
+
+/**
+ * @return the number of decision nodes on the longest root-to-leaf path.
+ */
+int DecisionTree::depth() const {
+    int result = 0;
+    for (const Path &path : paths()) {
+        result = std::max(result, (int) path.steps.size());
+    }
+    return result;
+}
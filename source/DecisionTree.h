@@ -0,0 +1,116 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#ifndef HOMOMORPHICTREEEVALUATOR_DECISIONTREE_H
+#define HOMOMORPHICTREEEVALUATOR_DECISIONTREE_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * A plaintext decision tree as held by the server. A decision node tests {@code feature < threshold}, or for bucketed
+ * and categorical features {@code lo <= feature < hi} or {@code feature == value}, and follows its true child when the
+ * test holds. Node 0 is the root.
+ *
+ * Models are stored as text, one statement per line ('#' starts a comment):
+ *      features <count>
+ *      integer <feature>...
+ *      node <id> <feature> <threshold> <true-child> <false-child>
+ *      range <id> <feature> <lo> <hi> <true-child> <false-child>
+ *      equal <id> <feature> <value> <true-child> <false-child>
+ *      leaf <id> <value>
+ * where a child is written as n<id> for a decision node or l<id> for a leaf. Thresholds and bounds may be real
+ * numbers; equality values and leaf values are integers. Thresholds, bounds and values lie in
+ * [-2^(BIT_SIZE - 2), 2^(BIT_SIZE - 2)) and leaf values in [0, 2^BIT_SIZE), see fitsLane and fitsResult.
+ *
+ * Features are real-valued unless an integer statement declares them integral. The bit circuits only see integers
+ * and compare with the rounded-up thresholds, which decides integers exactly; CkksEngine compares real-valued
+ * features at the threshold itself and integral ones halfway below it.
+ */
+class DecisionTree {
+public:
+    struct Child {
+        bool is_leaf;
+        int index;
+    };
+
+    enum class Test {
+        LESS_THAN, RANGE, EQUAL
+    };
+
+    struct Node {
+        int feature;
+        // The threshold of LESS_THAN, the lower bound of RANGE or the value of EQUAL, rounded up to an integer: an
+        // integer x is less than a real t exactly when it is less than ceil(t).
+        int threshold;
+        Child true_child;
+        Child false_child;
+        Test test = Test::LESS_THAN;
+        // The exclusive upper bound of RANGE, rounded up likewise.
+        int upper = 0;
+        // threshold and upper as written in the model.
+        double real_threshold = 0;
+        double real_upper = 0;
+
+        bool holds(int value) const;
+
+        bool holds(double value) const;
+    };
+
+    /**
+     * A root-to-leaf path. Each step is a decision node together with the branch taken out of it (true or false).
+     */
+    struct Path {
+        int leaf;
+        std::vector<std::pair<int, bool>> steps;
+    };
+
+    static DecisionTree load(const std::string &path);
+
+    static DecisionTree default_tree();
+
+    static DecisionTree synthetic(int depth, int node_count, int feature_count, unsigned seed);
+
+    static bool fitsLane(long value);
+
+    static std::string laneRange();
+
+    static bool fitsResult(long value);
+
+    int getFeatureCount() const;
+
+    int getNodeCount() const;
+
+    int getLeafCount() const;
+
+    const Node &getNode(int i) const;
+
+    int getLeafValue(int i) const;
+
+    bool isIntegral(int feature) const;
+
+    int classify(const std::vector<int> &features) const;
+
+    int classify(const std::vector<double> &features) const;
+
+    std::vector<Path> paths() const;
+
+    int depth() const;
+
+private:
+    void validate() const;
+
+    void markIntegral();
+
+    int feature_count = 0;
+    // One flag per feature, see isIntegral.
+    std::vector<bool> integral;
+    std::vector<Node> nodes;
+    std::vector<int> leaves;
+};
+
+
+#endif //HOMOMORPHICTREEEVALUATOR_DECISIONTREE_H
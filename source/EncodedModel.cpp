@@ -0,0 +1,157 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#include "EncodedModel.h"
+
+#include <map>
+#include "Lanes.h"
+#include "Trace.h"
+#include "TreeEvaluator.h"
+
+EncodedModel::EncodedModel(const DecisionTree &tree, helib::PubKey &pubkey)
+        : tree(tree), polynomial(LeafPolynomial::compile(tree)), one(pubkey) {}
+
+/**
+ * Encrypts the constants of {@code tree} under {@code pubkey}. Thresholds are stored negated because compareCtxt
+ * decides x < t by adding x and -t in two's complement. Thresholds and leaves are written into every lane, so the
+ * same encoded model serves single queries and queries packed with Lanes::pack. Range and equality nodes need no
+ * ciphertext; their threshold is left empty. When the tree is small enough and only tests less-than, the thresholds
+ * are also packed one node per lane, with the routing that moves packed features to their nodes' lanes.
+ * @param tree the plaintext model.
+ * @param context the context that the client's keys were generated for.
+ * @param pubkey the client's public key.
+ * @return the encoded model.
+ */
+std::shared_ptr<const EncodedModel>
+EncodedModel::encode(const DecisionTree &tree, helib::Context &context, helib::PubKey &pubkey) {
+    std::shared_ptr<EncodedModel> model(new EncodedModel(tree, pubkey));
+
+    bool less_than_only = true;
+    for (int i = 0; i < tree.getNodeCount(); i++) {
+        if (tree.getNode(i).test == DecisionTree::Test::LESS_THAN) {
+            model->thresholds.push_back(Lanes::encryptReplicated(context, pubkey, -tree.getNode(i).threshold));
+        } else {
+            // Range and equality tests use plaintext constants.
+            model->thresholds.emplace_back(pubkey);
+            less_than_only = false;
+        }
+    }
+    for (int i = 0; i < tree.getLeafCount(); i++) {
+        model->leaves.push_back(Lanes::encryptReplicated(context, pubkey, tree.getLeafValue(i)));
+    }
+
+    helib::Ptxt<helib::BGV> ptxt_one(context);
+    ptxt_one[0] = 1;
+    pubkey.Encrypt(model->one, ptxt_one);
+    helib::EncryptedArray ea(context);
+    HTE_TRACE_OP("totalSums", model->one, helib::totalSums(ea, model->one));
+
+    long lanes = Lanes::count(ea);
+    if (less_than_only && tree.getNodeCount() <= lanes && tree.getFeatureCount() <= lanes) {
+        std::vector<int> negated_thresholds;
+        std::map<long, std::vector<int>> sources_by_shift;
+        for (int i = 0; i < tree.getNodeCount(); i++) {
+            negated_thresholds.push_back(-tree.getNode(i).threshold);
+            sources_by_shift[i - tree.getNode(i).feature].push_back(tree.getNode(i).feature);
+        }
+        model->packed_thresholds.reset(new helib::Ctxt(Lanes::encryptPerLane(context, pubkey, negated_thresholds)));
+
+        for (auto &entry : sources_by_shift) {
+            helib::Ptxt<helib::BGV> sources(context);
+            for (int feature : entry.second) {
+                for (long i = feature * BIT_SIZE; i < (feature + 1) * BIT_SIZE; i++) {
+                    sources[i] = 1;
+                }
+            }
+            model->feature_routes.push_back({entry.first, sources});
+        }
+    }
+
+    return model;
+}
+
+const DecisionTree &EncodedModel::getTree() const {
+    return tree;
+}
+
+const LeafPolynomial &EncodedModel::getPolynomial() const {
+    return polynomial;
+}
+
+const helib::Ctxt &EncodedModel::getThreshold(int node) const {
+    return thresholds.at(node);
+}
+
+const helib::Ctxt &EncodedModel::getLeaf(int leaf) const {
+    return leaves.at(leaf);
+}
+
+const helib::Ctxt &EncodedModel::getOne() const {
+    return one;
+}
+
+/**
+ * @return true if the model can be evaluated on a single packed feature ciphertext, see
+ * TreeEvaluator::evaluate_packed_features.
+ */
+bool EncodedModel::supportsPackedFeatures() const {
+    return packed_thresholds != nullptr;
+}
+
+/**
+ * @return the negated threshold of node n in lane n.
+ */
+const helib::Ctxt &EncodedModel::getPackedThresholds() const {
+    return *packed_thresholds;
+}
+
+/**
+ * @return the routing stages, one per distinct (node - feature) distance, in increasing order of shift.
+ */
+const std::vector<EncodedModel::Route> &EncodedModel::getFeatureRoutes() const {
+    return feature_routes;
+}
+
+/**
+ * @return an estimate of the memory held by the model's ciphertexts and routing masks, in bytes.
+ */
+size_t EncodedModel::footprint() const {
+    size_t bytes = EncodedModel::ctxtBytes(one);
+    for (const helib::Ctxt &ctxt : thresholds) {
+        bytes += EncodedModel::ctxtBytes(ctxt);
+    }
+    for (const helib::Ctxt &ctxt : leaves) {
+        bytes += EncodedModel::ctxtBytes(ctxt);
+    }
+    if (packed_thresholds) {
+        bytes += EncodedModel::ctxtBytes(*packed_thresholds);
+    }
+    for (const Route &route : feature_routes) {
+        bytes += route.sources.size() * sizeof(long);
+    }
+    return bytes;
+}
+
+/**
+ * The ciphertext memory one evaluate_decision_tree call holds at its peak, besides the model: the inputs, one decision
+ * per node, the working copies of compareCtxt and rippleCompare, the live values of the leaf polynomial and the
+ * result. Every ciphertext is counted at the size of a fresh one; multiplications drop primes, so this errs high.
+ * @return an estimate in bytes.
+ */
+size_t EncodedModel::evaluationBytes() const {
+    const size_t compare_copies = 6;
+    size_t ctxts = tree.getFeatureCount() + tree.getNodeCount() + compare_copies + polynomial.getPeakValues() + 1;
+    return ctxts * EncodedModel::ctxtBytes(one);
+}
+
+/**
+ * A ciphertext holds each of its parts in double-CRT form: one residue polynomial of phi(m) words per prime of its
+ * prime set.
+ * @param ctxt a ciphertext.
+ * @return an estimate of the memory held by {@code ctxt}, in bytes.
+ */
+size_t EncodedModel::ctxtBytes(const helib::Ctxt &ctxt) {
+    return ctxt.partsSize() * ctxt.getPrimeSet().card() * ctxt.getContext().zMStar.getPhiM() * sizeof(long);
+}
@@ -0,0 +1,70 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#ifndef HOMOMORPHICTREEEVALUATOR_ENCODEDMODEL_H
+#define HOMOMORPHICTREEEVALUATOR_ENCODEDMODEL_H
+
+#include <memory>
+#include <vector>
+#include <helib/helib.h>
+#include "DecisionTree.h"
+#include "LeafPolynomial.h"
+
+/**
+ * A decision tree together with everything evaluate_decision_tree needs for it: its compiled leaf polynomial and
+ * the ciphertext constants, one threshold per node, one value per leaf and an all-ones ciphertext. An EncodedModel is
+ * immutable once built, so a query that holds a reference to one can keep using it while a newer model replaces it.
+ */
+class EncodedModel {
+public:
+    /**
+     * One stage of the routing from a packed feature ciphertext (feature f in lane f) to node lanes (node n's feature
+     * in lane n): the lanes selected by {@code sources} move {@code shift} lanes up.
+     */
+    struct Route {
+        long shift;
+        helib::Ptxt<helib::BGV> sources;
+    };
+
+    static std::shared_ptr<const EncodedModel>
+    encode(const DecisionTree &tree, helib::Context &context, helib::PubKey &pubkey);
+
+    const DecisionTree &getTree() const;
+
+    const LeafPolynomial &getPolynomial() const;
+
+    const helib::Ctxt &getThreshold(int node) const;
+
+    const helib::Ctxt &getLeaf(int leaf) const;
+
+    const helib::Ctxt &getOne() const;
+
+    bool supportsPackedFeatures() const;
+
+    const helib::Ctxt &getPackedThresholds() const;
+
+    const std::vector<Route> &getFeatureRoutes() const;
+
+    size_t footprint() const;
+
+    size_t evaluationBytes() const;
+
+    static size_t ctxtBytes(const helib::Ctxt &ctxt);
+
+private:
+    EncodedModel(const DecisionTree &tree, helib::PubKey &pubkey);
+
+    DecisionTree tree;
+    LeafPolynomial polynomial;
+    std::vector<helib::Ctxt> thresholds;
+    std::vector<helib::Ctxt> leaves;
+    helib::Ctxt one;
+    // Only set when every node tests less-than and every node and every feature fits in a lane of its own.
+    std::unique_ptr<helib::Ctxt> packed_thresholds;
+    std::vector<Route> feature_routes;
+};
+
+
+#endif //HOMOMORPHICTREEEVALUATOR_ENCODEDMODEL_H
@@ -0,0 +1,199 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#include "EncryptedAggregate.h"
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include "ExecutionPolicy.h"
+#include "Util.h"
+
+/**
+ * @param engine the engine the queries are encrypted and evaluated with.
+ * @param model the model, encoded by {@code engine}.
+ * @param kind the aggregate to compute.
+ */
+EncryptedAggregate::EncryptedAggregate(const CkksEngine &engine, std::shared_ptr<const CkksEngine::Model> model,
+                                       Kind kind)
+        : engine(engine), model(std::move(model)), kind(kind) {
+    sums.resize(kind == Kind::MEAN_SCORE ? 1 : this->model->tree.getLeafCount());
+}
+
+/**
+ * Evaluates a batch and adds its results to the running sums.
+ * @param features a batch made by CkksEngine::encrypt.
+ * @param rows the number of queries in the batch.
+ */
+void EncryptedAggregate::add(const std::vector<helib::Ctxt> &features, long rows) {
+    if (rows < 1 || rows > engine.slotCount())
+        throw std::invalid_argument("between 1 and " + std::to_string(engine.slotCount()) + " rows fit in a batch");
+
+    std::vector<helib::Ctxt> values;
+    if (kind == Kind::MEAN_SCORE) {
+        values.push_back(engine.evaluate(*model, features));
+    } else {
+        values = engine.leafIndicators(*model, features);
+    }
+    for (size_t i = 0; i < values.size(); i++) {
+        // Padding slots hold results too.
+        if (rows < engine.slotCount())
+            engine.keepSlots(values[i], 0, rows);
+        if (sums[i]) {
+            *sums[i] += values[i];
+        } else {
+            sums[i].reset(new helib::Ctxt(values[i]));
+        }
+    }
+    this->rows += rows;
+}
+
+/**
+ * Folds the running sums into the aggregate.
+ * @return for MEAN_SCORE, the mean score in every slot; for LEAF_HISTOGRAM, the number of queries that reach leaf l in
+ * slot l.
+ */
+helib::Ctxt EncryptedAggregate::finish() const {
+    if (rows == 0)
+        throw std::logic_error("nothing to aggregate");
+
+    if (kind == Kind::MEAN_SCORE) {
+        helib::Ctxt mean(*sums[0]);
+        engine.totalSums(mean);
+        mean.multByConstant(1.0 / rows);
+        return mean;
+    }
+    std::unique_ptr<helib::Ctxt> histogram;
+    for (size_t leaf = 0; leaf < sums.size(); leaf++) {
+        helib::Ctxt count(*sums[leaf]);
+        engine.totalSums(count);
+        engine.keepSlots(count, leaf, leaf + 1);
+        if (histogram) {
+            *histogram += count;
+        } else {
+            histogram.reset(new helib::Ctxt(count));
+        }
+    }
+    return *histogram;
+}
+
+/**
+ * @param result the ciphertext returned by finish.
+ * @return the mean score, or the count of every leaf. Both are approximate, like the results of CkksEngine.
+ */
+std::vector<double> EncryptedAggregate::decrypt(const helib::Ctxt &result) const {
+    return engine.decrypt(result, kind == Kind::MEAN_SCORE ? 1 : model->tree.getLeafCount());
+}
+
+/**
+ * @return the number of queries added so far.
+ */
+long EncryptedAggregate::getRows() const {
+    return rows;
+}
+
+/**
+ * @param kind "mean" or "histogram".
+ * @return the kind.
+ */
+EncryptedAggregate::Kind EncryptedAggregate::parseKind(const std::string &kind) {
+    if (kind == "mean")
+        return Kind::MEAN_SCORE;
+    if (kind == "histogram")
+        return Kind::LEAF_HISTOGRAM;
+    throw std::invalid_argument("unknown aggregate " + kind);
+}
+
+/**
+ * Like BulkScorer::parseRow, but for the real-valued features CkksEngine takes.
+ * @param line a comma-separated line.
+ * @param values receives the fields.
+ * @return false if a field is not a finite number.
+ */
+bool EncryptedAggregate::parseRow(const std::string &line, std::vector<double> &values) {
+    values.clear();
+    std::istringstream fields(line);
+    std::string field;
+    while (std::getline(fields, field, ',')) {
+        double value;
+        try {
+            size_t end;
+            value = std::stod(field, &end);
+            if (field.find_first_not_of(" \t\r", end) != std::string::npos)
+                return false;
+        } catch (const std::logic_error &) {
+            return false;
+        }
+        if (!std::isfinite(value))
+            return false;
+        values.push_back(value);
+    }
+    return true;
+}
+
+/**
+ * Aggregates a CSV file of feature rows, in the format BulkScorer reads but with real values allowed, and writes the
+ * decrypted aggregate.
+ * @param input_path the input CSV.
+ * @param tree the model.
+ * @param kind the aggregate to compute.
+ * @param out receives the mean score, or one {@code leaf,count} line per leaf.
+ * @return the number of rows aggregated.
+ */
+long EncryptedAggregate::run(const std::string &input_path, const DecisionTree &tree, Kind kind, std::ostream &out) {
+    std::ifstream in(input_path);
+    if (!in)
+        throw std::runtime_error("cannot read " + input_path);
+
+    CkksEngine engine{CkksEngine::Parameters()};
+    EncryptedAggregate aggregate(engine, engine.encode(tree), kind);
+    COED::ExecutionPolicy::Lease lease;
+
+    std::vector<std::vector<double>> batch;
+    auto flush = [&]() {
+        if (batch.empty())
+            return;
+        long rows = batch.size();
+        // Padding slots repeat the last row, which is in range, rather than holding zeros, which may not be.
+        batch.resize(engine.slotCount(), batch.back());
+        aggregate.add(engine.encrypt(batch), rows);
+        batch.clear();
+    };
+    std::string line;
+    std::vector<double> row;
+    for (long line_number = 1; std::getline(in, line); line_number++) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+        bool parsed = EncryptedAggregate::parseRow(line, row);
+        if (!parsed && line_number == 1)
+            continue;
+        if (!parsed || (int) row.size() != tree.getFeatureCount()) {
+            throw std::runtime_error(input_path + ":" + std::to_string(line_number) + ": expected " +
+                                     std::to_string(tree.getFeatureCount()) + " numeric features");
+        }
+        batch.push_back(row);
+        try {
+            engine.checkRange(tree, batch.back());
+        } catch (const std::out_of_range &e) {
+            throw std::runtime_error(input_path + ":" + std::to_string(line_number) + ": " + e.what());
+        }
+        if ((long) batch.size() == engine.slotCount())
+            flush();
+    }
+    flush();
+
+    std::vector<double> values = aggregate.decrypt(aggregate.finish());
+    if (kind == Kind::MEAN_SCORE) {
+        out << "mean," << values[0] << "\n";
+    } else {
+        out << "leaf,count\n";
+        for (size_t leaf = 0; leaf < values.size(); leaf++) {
+            out << leaf << "," << values[leaf] << "\n";
+        }
+    }
+    COED::Util::info("Aggregated " + std::to_string(aggregate.getRows()) + " rows into one ciphertext");
+    return aggregate.getRows();
+}
@@ -0,0 +1,59 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#ifndef HOMOMORPHICTREEEVALUATOR_ENCRYPTEDAGGREGATE_H
+#define HOMOMORPHICTREEEVALUATOR_ENCRYPTEDAGGREGATE_H
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <helib/helib.h>
+#include "CkksEngine.h"
+
+/**
+ * An aggregate over every query of a job, for analytics that need no per-row result: the mean score, or how many
+ * queries reach each leaf.
+ *
+ * Each batch is evaluated as usual and its results are added slot by slot into a running sum, one ciphertext for the
+ * mean and one per leaf for the histogram; the unused slots of a partial batch are masked out first. finish() then
+ * folds the slots with totalSums into a single ciphertext, so the client downloads and decrypts one ciphertext per job
+ * instead of one per batch.
+ *
+ * Aggregates are computed in CKKS: with BGV over p = 2, adding slots is addition modulo 2 and cannot count.
+ */
+class EncryptedAggregate {
+public:
+    enum class Kind {
+        MEAN_SCORE, LEAF_HISTOGRAM
+    };
+
+    EncryptedAggregate(const CkksEngine &engine, std::shared_ptr<const CkksEngine::Model> model, Kind kind);
+
+    void add(const std::vector<helib::Ctxt> &features, long rows);
+
+    helib::Ctxt finish() const;
+
+    std::vector<double> decrypt(const helib::Ctxt &result) const;
+
+    long getRows() const;
+
+    static Kind parseKind(const std::string &kind);
+
+    static long run(const std::string &input_path, const DecisionTree &tree, Kind kind, std::ostream &out);
+
+    static bool parseRow(const std::string &line, std::vector<double> &values);
+
+private:
+    const CkksEngine &engine;
+    std::shared_ptr<const CkksEngine::Model> model;
+    Kind kind;
+    // The running sums: one for the mean score, one per leaf for the histogram.
+    std::vector<std::unique_ptr<helib::Ctxt>> sums;
+    long rows = 0;
+};
+
+
+#endif //HOMOMORPHICTREEEVALUATOR_ENCRYPTEDAGGREGATE_H
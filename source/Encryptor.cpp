@@ -5,11 +5,16 @@
 
 #include "Encryptor.h"
 
+#include <cstdio>
 #include <iostream>
+#include <stdexcept>
 #include <helib/binaryArith.h>
 #include "FileSystem.h"
+#include "MappedFile.h"
 #include "assert.h"
 
+const std::string COED::Encryptor::BINARY_PUBLIC_KEY_MAGIC = "COED-PK-BINARY-1\n";
+
 COED::Encryptor::Encryptor(const std::string &secret_key_file_path, const std::string &public_key_file_path,
                            long plaintextModulus, long phiM, long lifting, long numOfBitsOfModulusChain,
                            long numOfColOfKeySwitchingMatrix)
@@ -90,6 +95,12 @@ COED::Encryptor::Encryptor(const std::string &private_key_file_path, const std::
               numOfColOfKeySwitchingMatrix);
 }
 
+/**
+ * Loads the context and keys written by the generating constructor, so that a restarted process can keep using the
+ * keys its clients already have. As in the generating constructor the secret key doubles as the public key (SecKey is
+ * a subclass of PubKey); the public key file is only checked for presence, it is meant for processes that must not
+ * see the secret key.
+ */
 COED::Encryptor::Encryptor(const std::string &secret_key_file_path, const std::string &public_key_file_path) {
     COED::FileSystem sk_fs(secret_key_file_path);
     sk_fs.open_input_stream();
@@ -105,21 +116,84 @@ COED::Encryptor::Encryptor(const std::string &secret_key_file_path, const std::s
     unsigned long m, p, r;
     std::vector<long> gens, ords;
     helib::readContextBase(sk_fs_if, m, p, r, gens, ords);
-    helib::readContextBase(pk_fs_if, m, p, r, gens, ords);
     context = new helib::Context(m, p, r, gens, ords);
 
     sk_fs_if >> *context;
     secret_key = new helib::SecKey(*context);
     sk_fs_if >> *secret_key;
+    public_key = secret_key;
+
+    encrypted_array = new helib::EncryptedArray(*context);
 
-    pk_fs_if >> *context;
-    public_key = new helib::PubKey(*context);
-    pk_fs_if >> *public_key;
+    plaintextModulus = p;
+    lifting = r;
+    phiM = m;
 
     sk_fs.close_input_stream();
     pk_fs.close_input_stream();
 }
 
+/**
+ * Loads only the context and public key, for processes that evaluate but must not decrypt. getSecretKey() returns
+ * nullptr on such an encryptor. The file is read through a read-only mapping and may be either the text format written
+ * by the generating constructor or the binary format written by writePublicKeyBinary, which parses much faster.
+ */
+COED::Encryptor::Encryptor(const std::string &public_key_file_path) : secret_key(nullptr) {
+    COED::MappedFile file(public_key_file_path);
+    std::istream &pk_in = file.stream();
+
+    if (file.startsWith(BINARY_PUBLIC_KEY_MAGIC)) {
+        pk_in.ignore(BINARY_PUBLIC_KEY_MAGIC.size());
+        context = helib::buildContextFromBinary(pk_in).release();
+        helib::readContextBinary(pk_in, *context);
+        public_key = new helib::PubKey(*context);
+        helib::readPubKeyBinary(pk_in, *public_key);
+
+        plaintextModulus = context->zMStar.getP();
+        lifting = context->alMod.getR();
+        phiM = context->zMStar.getM();
+    } else {
+        unsigned long m, p, r;
+        std::vector<long> gens, ords;
+        helib::readContextBase(pk_in, m, p, r, gens, ords);
+        context = new helib::Context(m, p, r, gens, ords);
+
+        pk_in >> *context;
+        public_key = new helib::PubKey(*context);
+        pk_in >> *public_key;
+
+        plaintextModulus = p;
+        lifting = r;
+        phiM = m;
+    }
+    assert(pk_in);
+
+    encrypted_array = new helib::EncryptedArray(*context);
+}
+
+/**
+ * Writes the context and public key in HElib's binary format, for the public-key-only constructor. Worker processes
+ * on one host then map the same file and parse it straight from the shared page cache. The file is replaced
+ * atomically, so a worker starting meanwhile never sees half of it. The secret key is never written.
+ * @param public_key_file_path the file to write.
+ */
+void COED::Encryptor::writePublicKeyBinary(const std::string &public_key_file_path) const {
+    const std::string temporary_path = public_key_file_path + ".tmp";
+    COED::FileSystem pk_fs(temporary_path);
+    pk_fs.open_output_stream(std::fstream::trunc | std::fstream::binary);
+    std::ofstream &pk_fs_of = pk_fs.get_output_stream();
+
+    pk_fs_of << BINARY_PUBLIC_KEY_MAGIC;
+    helib::writeContextBaseBinary(pk_fs_of, *context);
+    helib::writeContextBinary(pk_fs_of, *context);
+    helib::writePubKeyBinary(pk_fs_of, *public_key);
+    bool written = pk_fs_of.good();
+    pk_fs.close_output_stream();
+
+    if (!written || std::rename(temporary_path.c_str(), public_key_file_path.c_str()) != 0)
+        throw std::runtime_error("cannot write " + public_key_file_path);
+}
+
 COED::Encryptor::~Encryptor() {
 //    if(context != nullptr)
 //        delete context;
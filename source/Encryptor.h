@@ -12,16 +12,23 @@
 namespace COED {
     class Encryptor {
     public:
+        // Starts a public key file written by writePublicKeyBinary.
+        static const std::string BINARY_PUBLIC_KEY_MAGIC;
+
         Encryptor(const std::string &, const std::string &, long, long, long, long, long);
 
         Encryptor(const std::string &, const std::string &, long, long, long, long, long, long);
 
         Encryptor(const std::string &, const std::string &);
 
+        explicit Encryptor(const std::string &);
+
         ~Encryptor();
 
         void testEncryption();
 
+        void writePublicKeyBinary(const std::string &) const;
+
         static void fill_plaintext(helib::Ptxt<helib::BGV> &, const std::vector<bool> &);
 
         helib::Context *getContext() const;
@@ -0,0 +1,278 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#include "EvaluationScheduler.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include "CostEstimator.h"
+#include "ExecutionPolicy.h"
+#include "Lanes.h"
+#include "MemoryBudget.h"
+#include "TreeEvaluator.h"
+
+EvaluationScheduler::EvaluationScheduler(helib::Context &context, helib::PubKey &pubkey, const Options &options)
+        : context(context), pubkey(pubkey), ea(context), options(options),
+          busy_until(options.workers, Clock::now()), ms_per_unit(options.initial_ms_per_unit) {
+    if (options.coalesce_ms > 0) {
+        QueryCoalescer::Options coalescing;
+        coalescing.window_ms = options.coalesce_ms;
+        coalescer.reset(new QueryCoalescer(context, pubkey, coalescing));
+    }
+    for (int i = 0; i < options.workers; i++) {
+        workers.emplace_back(&EvaluationScheduler::work, this, i);
+    }
+}
+
+/**
+ * Stops the workers after their current job. Requests still queued fail with an exception.
+ */
+EvaluationScheduler::~EvaluationScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+
+    auto shutdown = std::make_exception_ptr(std::runtime_error("scheduler stopped"));
+    for (auto &entry : interactive) {
+        entry.second->promise.set_exception(shutdown);
+    }
+    for (auto &request : bulk) {
+        request->promise.set_exception(shutdown);
+    }
+}
+
+/**
+ * Estimates the work of one evaluation of {@code tree}, in units of one key-switching operation (a ciphertext
+ * multiplication or rotation), as counted by a CostEstimator dry run of the evaluation the request gets.
+ * @param tree the tree to estimate.
+ * @param priority INTERACTIVE for evaluate_single_query, BULK for the evaluate_decision_tree of a batch.
+ * @return the estimated cost.
+ */
+double EvaluationScheduler::estimate_cost(const DecisionTree &tree, Priority priority) {
+    CostEstimator::Report report = CostEstimator::estimate(
+            tree, CostEstimator::Parameters(), priority == Priority::INTERACTIVE
+                                               ? CostEstimator::Layout::SINGLE_QUERY
+                                               : CostEstimator::Layout::PER_FEATURE);
+    return report.multiplications + report.rotations;
+}
+
+/**
+ * @param tree the tree to estimate.
+ * @return the estimated latency of one interactive evaluation of {@code tree} on an idle worker, in milliseconds.
+ */
+double EvaluationScheduler::estimate_ms(const DecisionTree &tree) const {
+    double cost = request_cost(tree, Priority::INTERACTIVE);
+    std::lock_guard<std::mutex> lock(mutex);
+    return cost * ms_per_unit + (coalescer ? options.coalesce_ms : 0);
+}
+
+/**
+ * @param tree the tree of a request.
+ * @param priority its priority.
+ * @return the cost of the evaluation the request gets here: with a coalescer, interactive requests may be packed, so
+ * they are estimated like a bulk batch.
+ */
+double EvaluationScheduler::request_cost(const DecisionTree &tree, Priority priority) const {
+    return estimate_cost(tree, coalescer ? Priority::BULK : priority);
+}
+
+/**
+ * Submits one query. The returned admission tells whether the request was queued and, if so, when it is expected to
+ * finish; its future yields the encrypted result, or throws if the request missed its deadline before it could start.
+ * @param inputs one single-query ciphertext per feature of the model.
+ * @param model the model to evaluate; the request keeps it alive until it has run.
+ * @param priority INTERACTIVE for latency-sensitive requests, BULK for throughput work.
+ * @param deadline the time by which the result is needed.
+ * @return the admission decision.
+ */
+EvaluationScheduler::Admission
+EvaluationScheduler::submit(std::vector<helib::Ctxt> inputs, std::shared_ptr<const EncodedModel> model,
+                            Priority priority, Clock::time_point deadline) {
+    if ((int) inputs.size() != model->getTree().getFeatureCount())
+        throw std::invalid_argument("a query needs one ciphertext per feature of the model");
+    std::unique_ptr<Request> request(new Request{std::move(inputs), std::move(model), deadline, 0, {}});
+    request->cost = request_cost(request->model->getTree(), priority);
+
+    Admission admission{false, 0, "", {}};
+    std::unique_lock<std::mutex> lock(mutex);
+    Clock::time_point now = Clock::now();
+
+    if (priority == Priority::INTERACTIVE) {
+        // Work queued ahead of this request: every interactive request due no later, spread over all workers, after
+        // the first worker becomes free.
+        double ahead = 0;
+        for (auto it = interactive.begin(); it != interactive.end() && it->first <= deadline; ++it) {
+            ahead += it->second->cost;
+        }
+        Clock::time_point first_free = *std::min_element(busy_until.begin(), busy_until.end());
+        double wait_ms = std::max(0.0, std::chrono::duration<double, std::milli>(first_free - now).count());
+        admission.estimated_ms = wait_ms + (ahead / options.workers + request->cost) * ms_per_unit +
+                                 (coalescer ? options.coalesce_ms : 0);
+
+        if (interactive.size() >= options.max_interactive_queue) {
+            admission.reason = "interactive queue is full";
+        } else if (now + std::chrono::duration<double, std::milli>(admission.estimated_ms) > deadline) {
+            admission.reason = "deadline cannot be met";
+        } else {
+            admission.accepted = true;
+            admission.result = request->promise.get_future();
+            interactive_backlog += request->cost;
+            interactive.emplace(deadline, std::move(request));
+        }
+    } else {
+        // Bulk requests share a batch, so each one only pays for its lane.
+        long lanes = Lanes::count(ea);
+        double batches_ahead = (double) (bulk.size() / lanes + 1);
+        admission.estimated_ms = (interactive_backlog / options.workers + batches_ahead * request->cost) * ms_per_unit;
+
+        if (bulk.size() >= options.max_bulk_queue) {
+            admission.reason = "bulk queue is full";
+        } else {
+            admission.accepted = true;
+            admission.result = request->promise.get_future();
+            bulk.push_back(std::move(request));
+        }
+    }
+    lock.unlock();
+
+    if (admission.accepted)
+        cv.notify_all();
+    return admission;
+}
+
+/**
+ * The loop run by every worker thread.
+ * @param worker the index of the worker; the first reserved_interactive_workers never run bulk batches.
+ */
+void EvaluationScheduler::work(int worker) {
+    bool takes_bulk = worker >= options.reserved_interactive_workers ||
+                      options.workers <= options.reserved_interactive_workers;
+    long lanes = Lanes::count(ea);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        cv.wait(lock, [&] { return stopping || !interactive.empty() || (takes_bulk && !bulk.empty()); });
+        if (stopping)
+            return;
+
+        if (!interactive.empty()) {
+            auto first = interactive.begin();
+            std::unique_ptr<Request> request = std::move(first->second);
+            interactive.erase(first);
+            interactive_backlog -= request->cost;
+            busy_until[worker] = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double, std::milli>(request->cost * ms_per_unit));
+            lock.unlock();
+            run_interactive(std::move(request));
+        } else {
+            // Only requests for the same model can share a ciphertext.
+            std::vector<std::unique_ptr<Request>> batch;
+            while (!bulk.empty() && (long) batch.size() < lanes &&
+                   (batch.empty() || bulk.front()->model == batch.front()->model)) {
+                batch.push_back(std::move(bulk.front()));
+                bulk.pop_front();
+            }
+            busy_until[worker] = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double, std::milli>(batch.front()->cost * ms_per_unit));
+            lock.unlock();
+            run_bulk(std::move(batch));
+        }
+        lock.lock();
+        busy_until[worker] = Clock::now();
+    }
+}
+
+void EvaluationScheduler::run_interactive(std::unique_ptr<Request> request) {
+    Clock::time_point started = Clock::now();
+    if (started > request->deadline) {
+        request->promise.set_exception(std::make_exception_ptr(std::runtime_error("deadline exceeded")));
+        return;
+    }
+
+    try {
+        if (coalescer) {
+            // The coalescer takes the reservation and the lease for the whole batch.
+            request->promise.set_value(coalescer->evaluate(std::move(request->inputs), request->model));
+            // The time includes the window, so it says nothing about the latency of a cost unit.
+            return;
+        }
+        COED::MemoryBudget::Reservation reservation(request->model->evaluationBytes());
+        COED::ExecutionPolicy::Lease lease;
+        request->promise.set_value(TreeEvaluator::evaluate_single_query(request->inputs.data(), *request->model,
+                                                                        pubkey, context));
+    } catch (...) {
+        request->promise.set_exception(std::current_exception());
+    }
+    record(request->cost, started);
+}
+
+/**
+ * Packs every request of {@code batch} into its own lane, evaluates the model once and hands each request its lane
+ * of the result. Every request is cleared outside lane 0 first, so that one client's ciphertext cannot disturb
+ * another's lane.
+ * @param batch at most Lanes::count requests, all for the same model.
+ */
+void EvaluationScheduler::run_bulk(std::vector<std::unique_ptr<Request>> batch) {
+    Clock::time_point started = Clock::now();
+
+    std::vector<std::unique_ptr<Request>> live;
+    for (std::unique_ptr<Request> &request : batch) {
+        if (started > request->deadline) {
+            request->promise.set_exception(std::make_exception_ptr(std::runtime_error("deadline exceeded")));
+        } else {
+            live.push_back(std::move(request));
+        }
+    }
+    if (live.empty())
+        return;
+
+    try {
+        // The evaluation, and the unpacked results.
+        const EncodedModel &model = *live.front()->model;
+        COED::MemoryBudget::Reservation reservation(model.evaluationBytes() +
+                                                    live.size() * EncodedModel::ctxtBytes(model.getOne()));
+        COED::ExecutionPolicy::Lease lease;
+        helib::Ptxt<helib::BGV> lane = Lanes::mask(context, 0);
+        std::vector<helib::Ctxt> packed_inputs;
+        for (size_t feature = 0; feature < live.front()->inputs.size(); feature++) {
+            std::vector<helib::Ctxt> column;
+            for (std::unique_ptr<Request> &request : live) {
+                column.push_back(request->inputs.at(feature));
+                column.back().multByConstant(lane);
+            }
+            packed_inputs.push_back(Lanes::pack(column, ea));
+        }
+
+        helib::Ctxt result = TreeEvaluator::evaluate_decision_tree(packed_inputs.data(), model, pubkey, context);
+        std::vector<helib::Ctxt> results;
+        for (size_t lane = 0; lane < live.size(); lane++) {
+            results.push_back(Lanes::unpack(result, lane, ea));
+        }
+        for (size_t lane = 0; lane < live.size(); lane++) {
+            live[lane]->promise.set_value(results[lane]);
+        }
+    } catch (...) {
+        for (std::unique_ptr<Request> &request : live) {
+            request->promise.set_exception(std::current_exception());
+        }
+    }
+    record(live.front()->cost, started);
+}
+
+/**
+ * Folds a measured evaluation into the latency estimate used for admission.
+ * @param cost the estimated cost of the evaluation that just finished.
+ * @param started when it started.
+ */
+void EvaluationScheduler::record(double cost, Clock::time_point started) {
+    double elapsed_ms = std::chrono::duration<double, std::milli>(Clock::now() - started).count();
+    std::lock_guard<std::mutex> lock(mutex);
+    ms_per_unit = 0.8 * ms_per_unit + 0.2 * (elapsed_ms / cost);
+}
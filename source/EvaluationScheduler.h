@@ -0,0 +1,116 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#ifndef HOMOMORPHICTREEEVALUATOR_EVALUATIONSCHEDULER_H
+#define HOMOMORPHICTREEEVALUATOR_EVALUATIONSCHEDULER_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "EncodedModel.h"
+#include "QueryCoalescer.h"
+
+/**
+ * Sits in front of TreeEvaluator and decides what runs next.
+ *
+ * Interactive requests carry a deadline and are served earliest-deadline-first, each on its own with
+ * evaluate_single_query. They are admitted only if, given the work already queued ahead of them, their estimated
+ * completion time meets the deadline, so an overloaded server rejects early instead of answering late. Bulk requests
+ * are queued FIFO and only run when no interactive request is waiting; up to Lanes::count requests for the same model
+ * are then packed into the lanes of one ciphertext and evaluated together with evaluate_decision_tree. Some workers can
+ * be reserved for interactive requests so that a long bulk batch never holds every core.
+ *
+ * With a coalescing window, interactive requests go through a QueryCoalescer instead: requests for the same model that
+ * workers pick up within the window share one packed evaluation, up to one request per worker.
+ */
+class EvaluationScheduler {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    enum class Priority {
+        INTERACTIVE, BULK
+    };
+
+    struct Options {
+        int workers = std::max(1u, std::thread::hardware_concurrency());
+        // Workers that never pick up bulk batches.
+        int reserved_interactive_workers = 1;
+        size_t max_interactive_queue = 64;
+        size_t max_bulk_queue = 4096;
+        // Starting guess for the latency of one cost unit; refined from measured evaluations.
+        double initial_ms_per_unit = 20.0;
+        // How long an interactive request waits for others to share its evaluation; 0 to evaluate each on its own.
+        double coalesce_ms = 0;
+    };
+
+    struct Admission {
+        bool accepted;
+        // Estimated time from submission to the result being available.
+        double estimated_ms;
+        std::string reason;
+        std::future<helib::Ctxt> result;
+    };
+
+    EvaluationScheduler(helib::Context &context, helib::PubKey &pubkey, const Options &options);
+
+    ~EvaluationScheduler();
+
+    static double estimate_cost(const DecisionTree &tree, Priority priority);
+
+    double estimate_ms(const DecisionTree &tree) const;
+
+    Admission submit(std::vector<helib::Ctxt> inputs, std::shared_ptr<const EncodedModel> model, Priority priority,
+                     Clock::time_point deadline = Clock::time_point::max());
+
+private:
+    struct Request {
+        std::vector<helib::Ctxt> inputs;
+        std::shared_ptr<const EncodedModel> model;
+        Clock::time_point deadline;
+        double cost;
+        std::promise<helib::Ctxt> promise;
+    };
+
+    void work(int worker);
+
+    void run_interactive(std::unique_ptr<Request> request);
+
+    void run_bulk(std::vector<std::unique_ptr<Request>> batch);
+
+    double request_cost(const DecisionTree &tree, Priority priority) const;
+
+    void record(double cost, Clock::time_point started);
+
+    helib::Context &context;
+    helib::PubKey &pubkey;
+    helib::EncryptedArray ea;
+    Options options;
+    // Only set with a coalescing window.
+    std::unique_ptr<QueryCoalescer> coalescer;
+
+    mutable std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping = false;
+    std::multimap<Clock::time_point, std::unique_ptr<Request>> interactive;
+    std::deque<std::unique_ptr<Request>> bulk;
+    // Cost of the interactive requests currently queued.
+    double interactive_backlog = 0;
+    // Estimated time at which each worker finishes its current job.
+    std::vector<Clock::time_point> busy_until;
+    double ms_per_unit;
+
+    std::vector<std::thread> workers;
+};
+
+
+#endif //HOMOMORPHICTREEEVALUATOR_EVALUATIONSCHEDULER_H
@@ -0,0 +1,99 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#include "EvaluationSession.h"
+
+#include <stdexcept>
+#include "TreeEvaluator.h"
+
+/**
+ * @param model the model the session evaluates.
+ * @param pubkey the client's public key.
+ * @param context the context of the key.
+ */
+EvaluationSession::EvaluationSession(std::shared_ptr<const EncodedModel> model, helib::PubKey &pubkey,
+                                     helib::Context &context)
+        : model(std::move(model)), pubkey(pubkey), context(context) {
+    const DecisionTree &tree = this->model->getTree();
+    nodes_by_feature.resize(tree.getFeatureCount());
+    for (int i = 0; i < tree.getNodeCount(); i++) {
+        nodes_by_feature[tree.getNode(i).feature].push_back(i);
+    }
+}
+
+/**
+ * Evaluates a full input vector and caches everything computed on the way, replacing what an earlier call cached.
+ * @param inputs one ciphertext per feature of the model, as for TreeEvaluator::evaluate_decision_tree.
+ * @return an encrypted result obtained after the evaluation of the tree.
+ */
+helib::Ctxt EvaluationSession::evaluate(const std::vector<helib::Ctxt> &inputs) {
+    const DecisionTree &tree = model->getTree();
+    if ((int) inputs.size() != tree.getFeatureCount())
+        throw std::invalid_argument("expected " + std::to_string(tree.getFeatureCount()) + " features, got " +
+                                    std::to_string(inputs.size()));
+
+    decisions.clear();
+    values.clear();
+    for (int i = 0; i < tree.getNodeCount(); i++) {
+        decisions.push_back(TreeEvaluator::testNode(inputs[tree.getNode(i).feature], *model, i, context));
+        comparisons++;
+    }
+    return recompute(std::vector<bool>(tree.getNodeCount(), true));
+}
+
+/**
+ * Replaces some features of the last input vector and evaluates the result.
+ * @param features the new ciphertext of each changed feature, by feature index.
+ * @return an encrypted result obtained after the evaluation of the tree on the updated input vector.
+ */
+helib::Ctxt EvaluationSession::update(const std::map<int, helib::Ctxt> &features) {
+    if (decisions.empty())
+        throw std::logic_error("a session must evaluate a full input vector before it is updated");
+
+    std::vector<bool> changed(model->getTree().getNodeCount(), false);
+    for (const auto &feature : features) {
+        if (feature.first < 0 || feature.first >= (int) nodes_by_feature.size())
+            throw std::out_of_range("no feature " + std::to_string(feature.first));
+        for (int node : nodes_by_feature[feature.first]) {
+            decisions[node] = TreeEvaluator::testNode(feature.second, *model, node, context);
+            changed[node] = true;
+            comparisons++;
+        }
+    }
+    return recompute(changed);
+}
+
+/**
+ * @return the number of compareCtxt calls made by the session.
+ */
+long EvaluationSession::getComparisons() const {
+    return comparisons;
+}
+
+/**
+ * @return the number of ciphertext multiplications of the leaf polynomial made by the session.
+ */
+long EvaluationSession::getMultiplications() const {
+    return multiplications;
+}
+
+/**
+ * Re-evaluates the leaf polynomial after the decisions of {@code nodes} changed.
+ * @param nodes one flag per node.
+ */
+helib::Ctxt EvaluationSession::recompute(const std::vector<bool> &nodes) {
+    const LeafPolynomial &polynomial = model->getPolynomial();
+    std::vector<bool> stale = polynomial.dependents(nodes);
+    const std::vector<LeafPolynomial::Operand> &operands = polynomial.getOperands();
+    for (size_t i = 0; i < operands.size(); i++) {
+        if (operands[i].kind == LeafPolynomial::Kind::PRODUCT && (stale[i] || i >= values.size() || !values[i]))
+            multiplications++;
+    }
+
+    const EncodedModel &encoded = *model;
+    return polynomial.evaluate(decisions, [&encoded](int leaf) -> const helib::Ctxt & {
+        return encoded.getLeaf(leaf);
+    }, encoded.getOne(), stale, values);
+}
@@ -0,0 +1,55 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#ifndef HOMOMORPHICTREEEVALUATOR_EVALUATIONSESSION_H
+#define HOMOMORPHICTREEEVALUATOR_EVALUATIONSESSION_H
+
+#include <map>
+#include <memory>
+#include <vector>
+#include "EncodedModel.h"
+
+/**
+ * The server side of one client's session with a model, for clients that re-score after changing a few features.
+ *
+ * evaluate() scores a full input vector like TreeEvaluator::evaluate_decision_tree, but keeps every encrypted decision
+ * and every sub-product of the leaf polynomial. update() then takes only the features that changed: it redoes the
+ * comparisons of the nodes that test them and the products that depend on those decisions, and reuses everything else.
+ * In a wide tree where a feature is tested by few nodes, an update costs a small fraction of a full evaluation, at the
+ * price of holding about one ciphertext per node and per product for the lifetime of the session.
+ *
+ * A session is not thread-safe; each client has its own.
+ */
+class EvaluationSession {
+public:
+    EvaluationSession(std::shared_ptr<const EncodedModel> model, helib::PubKey &pubkey, helib::Context &context);
+
+    helib::Ctxt evaluate(const std::vector<helib::Ctxt> &inputs);
+
+    helib::Ctxt update(const std::map<int, helib::Ctxt> &features);
+
+    long getComparisons() const;
+
+    long getMultiplications() const;
+
+private:
+    helib::Ctxt recompute(const std::vector<bool> &nodes);
+
+    std::shared_ptr<const EncodedModel> model;
+    helib::PubKey &pubkey;
+    helib::Context &context;
+    std::vector<std::vector<int>> nodes_by_feature;
+
+    // One per node, empty until evaluate is called.
+    std::vector<helib::Ctxt> decisions;
+    // The values of the leaf polynomial's operands, see LeafPolynomial::evaluate.
+    std::vector<std::unique_ptr<helib::Ctxt>> values;
+    // Work done so far, for comparison with a full evaluation per query.
+    long comparisons = 0;
+    long multiplications = 0;
+};
+
+
+#endif //HOMOMORPHICTREEEVALUATOR_EVALUATIONSESSION_H
@@ -0,0 +1,122 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#include "ExecutionPolicy.h"
+
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <pthread.h>
+#include <sched.h>
+#include <NTL/BasicThreadPool.h>
+#include "Util.h"
+
+static std::mutex policy_mutex;
+static bool policy_configured = false;
+static COED::ExecutionPolicy::Options policy;
+// Cores not held by a running query, in ADAPTIVE mode.
+static int free_cores = 0;
+static int running_queries = 0;
+static std::atomic<int> next_slice(0);
+
+/**
+ * Resizes the calling thread's NTL pool, if it has another size. Resizing replaces the pool's threads.
+ * @param threads the threads that work on an operation, including the calling one.
+ */
+static void setPoolSize(int threads) {
+    // NTL runs single-threaded until SetNumThreads is called.
+    thread_local int current = 1;
+    if (threads != current) {
+        NTL::SetNumThreads(threads);
+        current = threads;
+    }
+}
+
+/**
+ * Binds the calling thread to slice {@code slice} of {@code slices} equal slices of the cores. Threads it starts
+ * afterwards, like those of its NTL pool, inherit the binding.
+ */
+static void pinToSlice(int slice, int slices, int cores) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int core = slice * cores / slices; core < (slice + 1) * cores / slices; core++) {
+        CPU_SET(core, &set);
+    }
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+        COED::Util::error("Cannot pin a query thread to cores " + std::to_string(slice * cores / slices) + " to " +
+                          std::to_string((slice + 1) * cores / slices - 1));
+}
+
+/**
+ * Sets the policy for the rest of the process.
+ * @param options the mode, the cores and the number of query threads.
+ */
+void COED::ExecutionPolicy::configure(const Options &options) {
+    if (options.cores < 1 || options.query_threads < 1)
+        throw std::invalid_argument("an execution policy needs at least one core and one query thread");
+    if (options.mode == Mode::PINNED && options.query_threads > options.cores)
+        throw std::invalid_argument("cannot pin more query threads than there are cores");
+
+    std::lock_guard<std::mutex> lock(policy_mutex);
+    if (policy_configured)
+        throw std::logic_error("the execution policy is already configured");
+    policy = options;
+    free_cores = options.cores;
+    policy_configured = true;
+}
+
+/**
+ * @param mode "adaptive", "static" or "pinned".
+ * @return the mode.
+ */
+COED::ExecutionPolicy::Mode COED::ExecutionPolicy::parseMode(const std::string &mode) {
+    if (mode == "adaptive")
+        return Mode::ADAPTIVE;
+    if (mode == "static")
+        return Mode::STATIC;
+    if (mode == "pinned")
+        return Mode::PINNED;
+    throw std::invalid_argument("unknown threading mode " + mode);
+}
+
+COED::ExecutionPolicy::Lease::Lease() : granted(1), shared(false) {
+    std::unique_lock<std::mutex> lock(policy_mutex);
+    if (!policy_configured)
+        return;
+    Options options = policy;
+    if (options.mode == Mode::ADAPTIVE) {
+        running_queries++;
+        granted = std::max(1, std::min(free_cores, options.cores / running_queries));
+        free_cores -= granted;
+        shared = true;
+    } else {
+        granted = std::max(1, options.cores / options.query_threads);
+    }
+    lock.unlock();
+
+    if (options.mode == Mode::PINNED) {
+        thread_local bool pinned = false;
+        if (!pinned) {
+            pinToSlice(next_slice++ % options.query_threads, options.query_threads, options.cores);
+            pinned = true;
+        }
+    }
+    setPoolSize(granted);
+}
+
+COED::ExecutionPolicy::Lease::~Lease() {
+    if (!shared)
+        return;
+    std::lock_guard<std::mutex> lock(policy_mutex);
+    free_cores += granted;
+    running_queries--;
+}
+
+/**
+ * @return the threads, including the calling one, that each operation of this evaluation runs on.
+ */
+int COED::ExecutionPolicy::Lease::threads() const {
+    return granted;
+}
@@ -0,0 +1,72 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#ifndef HOMOMORPHICTREEEVALUATOR_EXECUTIONPOLICY_H
+#define HOMOMORPHICTREEEVALUATOR_EXECUTIONPOLICY_H
+
+#include <algorithm>
+#include <string>
+#include <thread>
+
+namespace COED {
+    /**
+     * How the cores of the process are split between query-level threads (the workers of EvaluationScheduler,
+     * BulkScorer or LoadGenerator, each evaluating one query) and intra-operation threads (NTL's thread pool, which
+     * HElib uses to spread the CRT and NTT work of a single operation).
+     *
+     * NTL's pool belongs to the thread that sets it up, so every query thread has its own. A query thread takes a
+     * Lease around each evaluation, and the lease sizes that thread's pool:
+     *  - ADAPTIVE: the cores are shared among the queries running at the moment. A query alone gets every core, for
+     *    latency; under full load each gets one, for throughput. A query never takes cores that running queries hold,
+     *    so the pools never add up to more threads than cores, beyond the one thread every query needs.
+     *  - STATIC: every query thread gets cores / query_threads threads, whatever the load.
+     *  - PINNED: as STATIC, and each query thread and its pool are bound to their own slice of the cores, so that the
+     *    operating system does not migrate them between cores and caches.
+     *
+     * The policy is configured once, before the first evaluation. Until then leases leave NTL's default of a single
+     * thread alone.
+     */
+    class ExecutionPolicy {
+    public:
+        enum class Mode {
+            ADAPTIVE, STATIC, PINNED
+        };
+
+        struct Options {
+            Mode mode = Mode::ADAPTIVE;
+            // The cores to use, all by default.
+            int cores = std::max(1u, std::thread::hardware_concurrency());
+            // The query threads the process runs; only STATIC and PINNED use it.
+            int query_threads = 1;
+        };
+
+        static void configure(const Options &options);
+
+        static Mode parseMode(const std::string &mode);
+
+        /**
+         * Reserves intra-operation threads for one evaluation on the calling thread.
+         */
+        class Lease {
+        public:
+            Lease();
+
+            ~Lease();
+
+            Lease(const Lease &) = delete;
+
+            Lease &operator=(const Lease &) = delete;
+
+            int threads() const;
+
+        private:
+            int granted;
+            // Whether the threads were taken from the shared cores, to be given back.
+            bool shared;
+        };
+    };
+}
+
+#endif //HOMOMORPHICTREEEVALUATOR_EXECUTIONPOLICY_H
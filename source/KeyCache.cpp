@@ -0,0 +1,131 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#include "KeyCache.h"
+
+#include <cstring>
+#include <stdexcept>
+#include "Encryptor.h"
+#include "MappedFile.h"
+#include "Util.h"
+
+/**
+ * @param directory the directory holding one {@code <id>.pk} file per client.
+ * @param memory_budget the bytes loaded keys may take together, see ClientKeys::bytes. Contexts are not counted. The
+ * most recently used key is kept even if it alone exceeds the budget.
+ */
+KeyCache::KeyCache(const std::string &directory, size_t memory_budget)
+        : directory(directory),
+          cache("the key of client", memory_budget, [](const ClientKeys &client) { return client.bytes; }) {}
+
+/**
+ * Returns the keys of client {@code id}, loading them first if they are not cached.
+ * @param id a client ID; the name of its key file without the extension.
+ * @return the client's context and public key. The caller keeps them alive for as long as it holds on to them.
+ */
+std::shared_ptr<KeyCache::ClientKeys> KeyCache::get(const std::string &id) {
+    if (id.empty() || id == "." || id == ".." || id.find('/') != std::string::npos)
+        throw std::invalid_argument("invalid client ID " + id);
+    return cache.get(id, [this, &id] { return load(id); });
+}
+
+size_t KeyCache::getCachedBytes() const {
+    return cache.getCachedBytes();
+}
+
+/**
+ * @return the number of distinct contexts the cached keys use.
+ */
+size_t KeyCache::getContextCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t count = 0;
+    for (const auto &context : contexts) {
+        if (!context.second.expired())
+            count++;
+    }
+    return count;
+}
+
+long KeyCache::getHits() const {
+    return cache.getHits();
+}
+
+long KeyCache::getMisses() const {
+    return cache.getMisses();
+}
+
+/**
+ * Reads the key file of client {@code id}, reusing a context already in use if the file's context is identical.
+ * Called without the lock held.
+ * @param id a client ID.
+ * @return the client's keys.
+ */
+std::shared_ptr<KeyCache::ClientKeys> KeyCache::load(const std::string &id) {
+    const std::string path = directory + "/" + id + ".pk";
+    COED::MappedFile file(path);
+    std::istream &in = file.stream();
+    bool binary = file.startsWith(COED::Encryptor::BINARY_PUBLIC_KEY_MAGIC);
+    size_t start = binary ? COED::Encryptor::BINARY_PUBLIC_KEY_MAGIC.size() : 0;
+
+    std::shared_ptr<ClientKeys> keys = std::make_shared<ClientKeys>();
+    size_t context_bytes = 0;
+    keys->context = findContext(file.data() + start, file.size() - start, context_bytes);
+    in.seekg(start + context_bytes);
+    if (!keys->context) {
+        if (binary) {
+            keys->context.reset(helib::buildContextFromBinary(in).release());
+            helib::readContextBinary(in, *keys->context);
+        } else {
+            unsigned long m, p, r;
+            std::vector<long> gens, ords;
+            helib::readContextBase(in, m, p, r, gens, ords);
+            keys->context = std::make_shared<helib::Context>(m, p, r, gens, ords);
+            in >> *keys->context;
+        }
+        if (!in)
+            throw std::runtime_error("cannot read the context of " + path);
+        context_bytes = (size_t) in.tellg() - start;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        contexts[std::string(file.data() + start, context_bytes)] = keys->context;
+    }
+
+    keys->pubkey.reset(new helib::PubKey(*keys->context));
+    if (binary) {
+        helib::readPubKeyBinary(in, *keys->pubkey);
+    } else {
+        in >> *keys->pubkey;
+    }
+    if (!in)
+        throw std::runtime_error("cannot read the public key of " + path);
+    keys->bytes = file.size() - start - context_bytes;
+    COED::Util::info("Loaded the key of client " + id);
+    return keys;
+}
+
+/**
+ * Looks for a context in use whose serialized form starts {@code bytes}, dropping contexts no key uses any more.
+ * @param bytes the rest of a key file, from its context on.
+ * @param size the number of bytes.
+ * @param context_bytes set to the size of the matching context's serialized form.
+ * @return the matching context, or nullptr.
+ */
+std::shared_ptr<helib::Context> KeyCache::findContext(const char *bytes, size_t size, size_t &context_bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = contexts.begin(); it != contexts.end();) {
+        std::shared_ptr<helib::Context> context = it->second.lock();
+        if (!context) {
+            it = contexts.erase(it);
+            continue;
+        }
+        if (it->first.size() <= size && std::memcmp(it->first.data(), bytes, it->first.size()) == 0) {
+            context_bytes = it->first.size();
+            return context;
+        }
+        ++it;
+    }
+    context_bytes = 0;
+    return nullptr;
+}
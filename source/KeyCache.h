@@ -0,0 +1,63 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#ifndef HOMOMORPHICTREEEVALUATOR_KEYCACHE_H
+#define HOMOMORPHICTREEEVALUATOR_KEYCACHE_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <helib/helib.h>
+#include "LruCache.h"
+
+/**
+ * The public and evaluation keys of many clients, for serving several tenants from one process.
+ *
+ * Client {@code id} keeps its key in {@code <directory>/<id>.pk}, in either format the public-key-only
+ * COED::Encryptor reads (the binary one loads much faster). Keys are cached in a COED::LruCache: they are loaded on
+ * first use and kept until the loaded keys together exceed the memory budget, when the least recently used ones are
+ * dropped and loaded again when next needed. Requests holding a dropped key keep it alive until they finish.
+ * Concurrent requests for a key that is being loaded wait for that one load.
+ *
+ * Clients that use identical parameters share one helib::Context: a key file whose context section matches, byte for
+ * byte, that of a key already loaded skips building the context. A context is freed with the last key using it.
+ */
+class KeyCache {
+public:
+    struct ClientKeys {
+        std::shared_ptr<helib::Context> context;
+        std::unique_ptr<helib::PubKey> pubkey;
+        // The size of the key in its file, which for the binary format is close to its size in memory.
+        size_t bytes = 0;
+    };
+
+    KeyCache(const std::string &directory, size_t memory_budget);
+
+    std::shared_ptr<ClientKeys> get(const std::string &id);
+
+    size_t getCachedBytes() const;
+
+    size_t getContextCount() const;
+
+    long getHits() const;
+
+    long getMisses() const;
+
+private:
+    std::shared_ptr<ClientKeys> load(const std::string &id);
+
+    std::shared_ptr<helib::Context> findContext(const char *bytes, size_t size, size_t &context_bytes);
+
+    std::string directory;
+    COED::LruCache<ClientKeys> cache;
+
+    mutable std::mutex mutex;
+    // Contexts in use, by their serialized form.
+    std::map<std::string, std::weak_ptr<helib::Context>> contexts;
+};
+
+
+#endif //HOMOMORPHICTREEEVALUATOR_KEYCACHE_H
@@ -0,0 +1,214 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#include "Lanes.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include "Trace.h"
+#include "TreeEvaluator.h"
+
+/**
+ * @param ea the EncryptedArray of the context.
+ * @return how many whole lanes fit in a ciphertext. Slots past the last whole lane are never used.
+ */
+long Lanes::count(const helib::EncryptedArray &ea) {
+    return ea.size() / BIT_SIZE;
+}
+
+/**
+ * @param context the address of the helib::context object.
+ * @param lane the first lane to select.
+ * @param count the number of consecutive lanes to select.
+ * @return a plaintext with 1 in every slot of the selected lanes and 0 elsewhere.
+ */
+helib::Ptxt<helib::BGV> Lanes::mask(const helib::Context &context, long lane, long count) {
+    helib::Ptxt<helib::BGV> ptxt(context);
+    for (long i = lane * BIT_SIZE; i < (lane + count) * BIT_SIZE && i < ptxt.size(); i++) {
+        ptxt[i] = 1;
+    }
+    return ptxt;
+}
+
+/**
+ * @param context the address of the helib::context object.
+ * @param bit a bit position within a lane, 0 being the MSB.
+ * @return a plaintext with 1 at position {@code bit} of every whole lane and 0 elsewhere.
+ */
+helib::Ptxt<helib::BGV> Lanes::bitMask(const helib::Context &context, int bit) {
+    helib::Ptxt<helib::BGV> ptxt(context);
+    long lanes = ptxt.size() / BIT_SIZE;
+    for (long lane = 0; lane < lanes; lane++) {
+        ptxt[lane * BIT_SIZE + bit] = 1;
+    }
+    return ptxt;
+}
+
+/**
+ * @param context the address of the helib::context object.
+ * @param bit a bit position within a lane, 0 being the MSB.
+ * @return the complement of bitMask: 0 at position {@code bit} of every whole lane and 1 elsewhere.
+ */
+helib::Ptxt<helib::BGV> Lanes::clearBitMask(const helib::Context &context, int bit) {
+    helib::Ptxt<helib::BGV> ptxt(context);
+    for (long i = 0; i < ptxt.size(); i++) {
+        ptxt[i] = (i % BIT_SIZE == bit) ? 0 : 1;
+    }
+    return ptxt;
+}
+
+/**
+ * @param context the address of the helib::context object.
+ * @param begin the first bit position within a lane, 0 being the MSB.
+ * @param end one past the last bit position.
+ * @return a plaintext with 1 at positions [begin, end) of every whole lane and 0 elsewhere.
+ */
+helib::Ptxt<helib::BGV> Lanes::bitRangeMask(const helib::Context &context, int begin, int end) {
+    helib::Ptxt<helib::BGV> ptxt(context);
+    long lanes = ptxt.size() / BIT_SIZE;
+    for (long lane = 0; lane < lanes; lane++) {
+        for (int bit = begin; bit < end; bit++) {
+            ptxt[lane * BIT_SIZE + bit] = 1;
+        }
+    }
+    return ptxt;
+}
+
+/**
+ * @param context the address of the helib::context object.
+ * @param val the value which is to be encoded as binary in every lane.
+ * @return the plaintext of encryptReplicated.
+ */
+helib::Ptxt<helib::BGV> Lanes::encodeReplicated(const helib::Context &context, int val) {
+    int bin[BIT_SIZE];
+    getBin(val, bin);
+
+    helib::Ptxt<helib::BGV> ptxt(context);
+    long lanes = ptxt.size() / BIT_SIZE;
+    for (long lane = 0; lane < lanes; lane++) {
+        for (int index = 0; index < BIT_SIZE; index++) {
+            ptxt[lane * BIT_SIZE + index] = bin[index];
+        }
+    }
+    return ptxt;
+}
+
+/**
+ * Like TreeEvaluator::getCtxt(3, ...), but the binary representation of {@code val} is written into every lane, so
+ * that the ciphertext can be combined with a ciphertext carrying a different query in each lane.
+ * @param context the address of the helib::context object.
+ * @param pubkey the address client's public key.
+ * @param val the value which is to be encoded as binary in every lane.
+ * @return the created ciphertext.
+ */
+helib::Ctxt Lanes::encryptReplicated(helib::Context &context, helib::PubKey &pubkey, int val) {
+    helib::Ptxt<helib::BGV> ptxt = Lanes::encodeReplicated(context, val);
+    helib::Ctxt ctxt(pubkey);
+    HTE_TRACE_OP("encrypt", ctxt, pubkey.Encrypt(ctxt, ptxt));
+    return ctxt;
+}
+
+/**
+ * Encodes several values at once, the binary representation of {@code values[k]} going into lane k.
+ * @param context the address of the helib::context object.
+ * @param values at most count() values.
+ * @return the encoded plaintext.
+ */
+helib::Ptxt<helib::BGV> Lanes::encodePerLane(const helib::Context &context, const std::vector<int> &values) {
+    helib::Ptxt<helib::BGV> ptxt(context);
+    if ((long) values.size() > ptxt.size() / BIT_SIZE) {
+        throw std::invalid_argument("more values than lanes");
+    }
+    int bin[BIT_SIZE];
+    for (size_t lane = 0; lane < values.size(); lane++) {
+        getBin(values[lane], bin);
+        for (int index = 0; index < BIT_SIZE; index++) {
+            ptxt[lane * BIT_SIZE + index] = bin[index];
+        }
+    }
+    return ptxt;
+}
+
+/**
+ * Encrypts several values at once, the binary representation of {@code values[k]} going into lane k.
+ * @param context the address of the helib::context object.
+ * @param pubkey the address client's public key.
+ * @param values at most count() values.
+ * @return the created ciphertext.
+ */
+helib::Ctxt Lanes::encryptPerLane(helib::Context &context, helib::PubKey &pubkey, const std::vector<int> &values) {
+    helib::Ctxt ctxt(pubkey);
+    helib::Ptxt<helib::BGV> ptxt = Lanes::encodePerLane(context, values);
+    HTE_TRACE_OP("encrypt", ctxt, pubkey.Encrypt(ctxt, ptxt));
+    return ctxt;
+}
+
+/**
+ * Packs single-query ciphertexts into one: {@code ctxts[k]} is moved from lane 0 to lane k. Every input must be zero
+ * outside lane 0, which holds for ciphertexts made by TreeEvaluator::getCtxt.
+ * @param ctxts at most count(ea) ciphertexts.
+ * @param ea the EncryptedArray of the context.
+ * @return a ciphertext holding {@code ctxts[k]} in lane k.
+ */
+helib::Ctxt Lanes::pack(const std::vector<helib::Ctxt> &ctxts, const helib::EncryptedArray &ea) {
+    helib::Ctxt packed(ctxts.at(0));
+    for (size_t k = 1; k < ctxts.size(); k++) {
+        helib::Ctxt shifted(ctxts[k]);
+        HTE_TRACE_OP("rotate", shifted, ea.rotate(shifted, k * BIT_SIZE));
+        packed += shifted;
+    }
+    return packed;
+}
+
+/**
+ * The inverse of pack: moves {@code lane} to lane 0 and clears everything else.
+ * @param ctxt a packed ciphertext.
+ * @param lane the lane to extract.
+ * @param ea the EncryptedArray of the context.
+ * @return a single-query ciphertext.
+ */
+helib::Ctxt Lanes::unpack(const helib::Ctxt &ctxt, long lane, const helib::EncryptedArray &ea) {
+    helib::Ctxt single(ctxt);
+    if (lane != 0) {
+        HTE_TRACE_OP("rotate", single, ea.rotate(single, -lane * BIT_SIZE));
+    }
+    single.multByConstant(Lanes::mask(ctxt.getContext(), 0));
+    return single;
+}
+
+/**
+ * Copies lane 0 into lanes 1 to count - 1 by repeated doubling, in ceil(log2(count)) rotations. All other lanes must be
+ * zero, and stay so.
+ * @param ctxt a single-query ciphertext.
+ * @param count the number of copies wanted, at most count(ea).
+ * @param ea the EncryptedArray of the context.
+ */
+void Lanes::replicate(helib::Ctxt &ctxt, long count, const helib::EncryptedArray &ea) {
+    long width = 1;
+    while (width < count) {
+        long step = std::min(width, count - width);
+        helib::Ctxt shifted(ctxt);
+        if (step < width) {
+            shifted.multByConstant(Lanes::mask(ctxt.getContext(), 0, step));
+        }
+        HTE_TRACE_OP("rotate", shifted, ea.rotate(shifted, width * BIT_SIZE));
+        ctxt += shifted;
+        width += step;
+    }
+}
+
+/**
+ * Copies the MSB of every lane into the other slots of the same lane. All other slots must already be zero. Takes
+ * log2(BIT_SIZE) rotations, against log2(slots) for totalSums, and never mixes lanes.
+ * @param ctxt a ciphertext that is zero everywhere except at the MSB of each lane.
+ * @param ea the EncryptedArray of the context.
+ */
+void Lanes::broadcastMsb(helib::Ctxt &ctxt, const helib::EncryptedArray &ea) {
+    for (int shift = 1; shift < BIT_SIZE; shift *= 2) {
+        helib::Ctxt shifted(ctxt);
+        HTE_TRACE_OP("rotate", shifted, ea.rotate(shifted, shift));
+        ctxt += shifted;
+    }
+}
@@ -0,0 +1,48 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#ifndef HOMOMORPHICTREEEVALUATOR_LANES_H
+#define HOMOMORPHICTREEEVALUATOR_LANES_H
+
+#include <vector>
+#include <helib/helib.h>
+
+/**
+ * A ciphertext has far more slots than the BIT_SIZE bits of one number. Slots are therefore split into lanes of
+ * BIT_SIZE consecutive slots, lane k holding slots [k * BIT_SIZE, (k + 1) * BIT_SIZE) with its MSB first. A single
+ * query lives in lane 0; packing several queries into the lanes of one ciphertext evaluates all of them for the price
+ * of one.
+ */
+class Lanes {
+public:
+    static long count(const helib::EncryptedArray &ea);
+
+    static helib::Ptxt<helib::BGV> mask(const helib::Context &context, long lane, long count = 1);
+
+    static helib::Ptxt<helib::BGV> bitMask(const helib::Context &context, int bit);
+
+    static helib::Ptxt<helib::BGV> clearBitMask(const helib::Context &context, int bit);
+
+    static helib::Ptxt<helib::BGV> bitRangeMask(const helib::Context &context, int begin, int end);
+
+    static helib::Ptxt<helib::BGV> encodeReplicated(const helib::Context &context, int val);
+
+    static helib::Ctxt encryptReplicated(helib::Context &context, helib::PubKey &pubkey, int val);
+
+    static helib::Ptxt<helib::BGV> encodePerLane(const helib::Context &context, const std::vector<int> &values);
+
+    static helib::Ctxt encryptPerLane(helib::Context &context, helib::PubKey &pubkey, const std::vector<int> &values);
+
+    static helib::Ctxt pack(const std::vector<helib::Ctxt> &ctxts, const helib::EncryptedArray &ea);
+
+    static helib::Ctxt unpack(const helib::Ctxt &ctxt, long lane, const helib::EncryptedArray &ea);
+
+    static void replicate(helib::Ctxt &ctxt, long count, const helib::EncryptedArray &ea);
+
+    static void broadcastMsb(helib::Ctxt &ctxt, const helib::EncryptedArray &ea);
+};
+
+
+#endif //HOMOMORPHICTREEEVALUATOR_LANES_H
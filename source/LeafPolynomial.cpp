@@ -0,0 +1,332 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#include "LeafPolynomial.h"
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include "EncodedModel.h"
+#include "Trace.h"
+
+/**
+ * Compiles the leaf polynomial of {@code tree}.
+ * @param tree the tree to compile.
+ * @param with_leaves whether each term ends in its leaf value. Without, every path is a term, zero leaves included.
+ * @return the compiled plan.
+ */
+LeafPolynomial LeafPolynomial::compile(const DecisionTree &tree, bool with_leaves) {
+    LeafPolynomial polynomial;
+
+    // Literals first: operand 2n is d_n, 2n + 1 is 1 - d_n, and 2 * nodes + l is leaf l. Unused ones are skipped by
+    // evaluate.
+    for (int node = 0; node < tree.getNodeCount(); node++) {
+        polynomial.operands.push_back({Kind::DECISION, node, -1, -1, 0});
+        polynomial.operands.push_back({Kind::COMPLEMENT, node, -1, -1, 0});
+    }
+    for (int leaf = 0; leaf < tree.getLeafCount(); leaf++) {
+        polynomial.operands.push_back({Kind::LEAF, leaf, -1, -1, 0});
+    }
+
+    std::map<std::vector<int>, int> memo;
+    for (const DecisionTree::Path &path : tree.paths()) {
+        // A zero leaf adds nothing to the sum.
+        if (with_leaves && tree.getLeafValue(path.leaf) == 0)
+            continue;
+        std::vector<int> factors;
+        for (const std::pair<int, bool> &step : path.steps) {
+            factors.push_back(2 * step.first + (step.second ? 0 : 1));
+        }
+        if (with_leaves) {
+            factors.push_back(2 * tree.getNodeCount() + path.leaf);
+        } else if (factors.empty()) {
+            throw std::invalid_argument("a tree without decisions has no path indicators");
+        }
+        polynomial.terms.push_back(polynomial.product(factors, 0, factors.size(), memo));
+        polynomial.term_leaves.push_back(path.leaf);
+    }
+    return polynomial;
+}
+
+/**
+ * Adds (or reuses) the product of {@code factors[begin, end)}. The range is split after the largest power of two
+ * shorter than it, which keeps the depth at ceil(log2(end - begin)) and makes common path prefixes map to the same
+ * sub-products.
+ * @return the operand holding the product.
+ */
+int LeafPolynomial::product(const std::vector<int> &factors, size_t begin, size_t end,
+                            std::map<std::vector<int>, int> &memo) {
+    if (end - begin == 1)
+        return factors[begin];
+
+    std::vector<int> key(factors.begin() + begin, factors.begin() + end);
+    auto found = memo.find(key);
+    if (found != memo.end())
+        return found->second;
+
+    size_t half = 1;
+    while (half * 2 < end - begin) {
+        half *= 2;
+    }
+    int left = product(factors, begin, begin + half, memo);
+    int right = product(factors, begin + half, end, memo);
+    operands.push_back({Kind::PRODUCT, -1, left, right,
+                        std::max(operands[left].depth, operands[right].depth) + 1});
+    memo[key] = operands.size() - 1;
+    return operands.size() - 1;
+}
+
+/**
+ * Evaluates the plan. Intermediate products are released as soon as their last use has been computed.
+ * @param model the encoded model that supplies the leaf values and the all-ones ciphertext.
+ * @param decisions one encrypted decision per node, as returned by compareCtxt.
+ * @return a single ciphertext that is the result of evaluation of the tree.
+ */
+helib::Ctxt LeafPolynomial::evaluate(const EncodedModel &model, const std::vector<helib::Ctxt> &decisions) const {
+    return evaluate(decisions, [&model](int leaf) -> const helib::Ctxt & { return model.getLeaf(leaf); },
+                    model.getOne());
+}
+
+/**
+ * Evaluates the plan on decisions and leaves of any scheme, e.g. the soft decisions of CkksEngine.
+ * @param decisions one encrypted decision per node, 1 where the node's test holds and 0 where it does not.
+ * @param leaf returns the encrypted value of a leaf.
+ * @param one a ciphertext of the same scheme holding 1 in every slot the decisions use.
+ * @return a single ciphertext that is the result of evaluation of the tree.
+ */
+helib::Ctxt LeafPolynomial::evaluate(const std::vector<helib::Ctxt> &decisions,
+                                     const std::function<const helib::Ctxt &(int)> &leaf,
+                                     const helib::Ctxt &one) const {
+    std::vector<helib::Ctxt> values = evaluateTerms(decisions, leaf, one);
+    return sum([&values](size_t term) -> const helib::Ctxt & { return values[term]; }, one);
+}
+
+/**
+ * Evaluates each term of the plan without adding them up. Intermediate products are released as soon as their last
+ * use has been computed.
+ * @param decisions one encrypted decision per node, 1 where the node's test holds and 0 where it does not.
+ * @param leaf returns the encrypted value of a leaf; not called for a plan compiled without leaves.
+ * @param one a ciphertext of the same scheme holding 1 in every slot the decisions use.
+ * @return one value per term, see getTermLeaves.
+ */
+std::vector<helib::Ctxt> LeafPolynomial::evaluateTerms(const std::vector<helib::Ctxt> &decisions,
+                                                       const std::function<const helib::Ctxt &(int)> &leaf,
+                                                       const helib::Ctxt &one) const {
+    HTE_TRACE("leaf polynomial", one);
+    std::vector<int> uses = countUses();
+    std::vector<std::unique_ptr<helib::Ctxt>> values(operands.size());
+    // Decisions and leaves are read in place, not copied.
+    auto value = [&](int i) -> const helib::Ctxt & {
+        switch (operands[i].kind) {
+            case Kind::DECISION:
+                return decisions[operands[i].index];
+            case Kind::LEAF:
+                return leaf(operands[i].index);
+            default:
+                return *values[i];
+        }
+    };
+    auto release = [&](int i) {
+        if (--uses[i] == 0)
+            values[i].reset();
+    };
+
+    for (size_t i = 0; i < operands.size(); i++) {
+        const Operand &operand = operands[i];
+        if (uses[i] == 0)
+            continue;
+        if (operand.kind == Kind::COMPLEMENT) {
+            values[i].reset(new helib::Ctxt(one));
+            values[i]->addCtxt(decisions[operand.index], true);
+        } else if (operand.kind == Kind::PRODUCT) {
+            values[i].reset(new helib::Ctxt(value(operand.left)));
+            HTE_TRACE_OP("multiplyBy", *values[i], values[i]->multiplyBy(value(operand.right)));
+            release(operand.left);
+            release(operand.right);
+        }
+    }
+
+    std::vector<helib::Ctxt> results;
+    results.reserve(terms.size());
+    for (int term : terms) {
+        results.push_back(value(term));
+        release(term);
+    }
+    return results;
+}
+
+/**
+ * Evaluates the plan reusing the values of an earlier evaluation, e.g. after some decisions changed. Only operands
+ * marked {@code stale}, or not computed yet, are computed; all values are kept for the next call.
+ * @param decisions one encrypted decision per node.
+ * @param leaf returns the encrypted value of a leaf.
+ * @param one a ciphertext of the same scheme holding 1 in every slot the decisions use.
+ * @param stale the operands whose inputs changed since {@code values} were computed, see dependents.
+ * @param values one value per operand, empty for decisions and leaves; filled in on the first call.
+ * @return a single ciphertext that is the result of evaluation of the tree.
+ */
+helib::Ctxt LeafPolynomial::evaluate(const std::vector<helib::Ctxt> &decisions,
+                                     const std::function<const helib::Ctxt &(int)> &leaf, const helib::Ctxt &one,
+                                     const std::vector<bool> &stale,
+                                     std::vector<std::unique_ptr<helib::Ctxt>> &values) const {
+    HTE_TRACE("leaf polynomial", one);
+    values.resize(operands.size());
+    auto value = [&](int i) -> const helib::Ctxt & {
+        switch (operands[i].kind) {
+            case Kind::DECISION:
+                return decisions[operands[i].index];
+            case Kind::LEAF:
+                return leaf(operands[i].index);
+            default:
+                return *values[i];
+        }
+    };
+
+    for (size_t i = 0; i < operands.size(); i++) {
+        const Operand &operand = operands[i];
+        if (values[i] && !stale[i])
+            continue;
+        if (operand.kind == Kind::COMPLEMENT) {
+            values[i].reset(new helib::Ctxt(one));
+            values[i]->addCtxt(decisions[operand.index], true);
+        } else if (operand.kind == Kind::PRODUCT) {
+            values[i].reset(new helib::Ctxt(value(operand.left)));
+            HTE_TRACE_OP("multiplyBy", *values[i], values[i]->multiplyBy(value(operand.right)));
+        }
+    }
+    return sum([&](size_t term) -> const helib::Ctxt & { return value(terms[term]); }, one);
+}
+
+/**
+ * @return for each operand, the number of products and terms that use it.
+ */
+std::vector<int> LeafPolynomial::countUses() const {
+    std::vector<int> uses(operands.size(), 0);
+    for (const Operand &operand : operands) {
+        if (operand.kind == Kind::PRODUCT) {
+            uses[operand.left]++;
+            uses[operand.right]++;
+        }
+    }
+    for (int term : terms) {
+        uses[term]++;
+    }
+    return uses;
+}
+
+/**
+ * @param nodes the nodes whose decisions changed, one flag per node.
+ * @return one flag per operand: whether its value depends on one of those decisions.
+ */
+std::vector<bool> LeafPolynomial::dependents(const std::vector<bool> &nodes) const {
+    std::vector<bool> dependent(operands.size(), false);
+    for (size_t i = 0; i < operands.size(); i++) {
+        const Operand &operand = operands[i];
+        if (operand.kind == Kind::DECISION || operand.kind == Kind::COMPLEMENT) {
+            dependent[i] = nodes.at(operand.index);
+        } else if (operand.kind == Kind::PRODUCT) {
+            dependent[i] = dependent[operand.left] || dependent[operand.right];
+        }
+    }
+    return dependent;
+}
+
+/**
+ * Adds up the terms; the result is zero if there are none.
+ * @param term returns the value of the term at a position of getTerms.
+ * @param one a ciphertext of the scheme evaluated in.
+ */
+helib::Ctxt LeafPolynomial::sum(const std::function<const helib::Ctxt &(size_t)> &term, const helib::Ctxt &one) const {
+    if (terms.empty()) {
+        helib::Ctxt zero(one);
+        zero.addCtxt(one, true);
+        return zero;
+    }
+    helib::Ctxt result(term(0));
+    for (size_t i = 1; i < terms.size(); i++) {
+        result.addCtxt(term(i));
+    }
+    return result;
+}
+
+const std::vector<LeafPolynomial::Operand> &LeafPolynomial::getOperands() const {
+    return operands;
+}
+
+const std::vector<int> &LeafPolynomial::getTerms() const {
+    return terms;
+}
+
+/**
+ * @return the leaf of each term, in the order of getTerms.
+ */
+const std::vector<int> &LeafPolynomial::getTermLeaves() const {
+    return term_leaves;
+}
+
+/**
+ * @return the multiplicative depth the polynomial adds on top of the decisions.
+ */
+int LeafPolynomial::getDepth() const {
+    int depth = 0;
+    for (int term : terms) {
+        depth = std::max(depth, operands[term].depth);
+    }
+    return depth;
+}
+
+/**
+ * @return the number of ciphertext multiplications in the plan.
+ */
+int LeafPolynomial::getMultiplications() const {
+    return std::count_if(operands.begin(), operands.end(),
+                         [](const Operand &operand) { return operand.kind == Kind::PRODUCT; });
+}
+
+/**
+ * @return the number of distinct 1-d complements the plan uses.
+ */
+int LeafPolynomial::getComplements() const {
+    std::vector<bool> used(operands.size(), false);
+    for (const Operand &operand : operands) {
+        if (operand.kind == Kind::PRODUCT) {
+            used[operand.left] = true;
+            used[operand.right] = true;
+        }
+    }
+    for (int term : terms) {
+        used[term] = true;
+    }
+    int complements = 0;
+    for (size_t i = 0; i < operands.size(); i++) {
+        if (used[i] && operands[i].kind == Kind::COMPLEMENT)
+            complements++;
+    }
+    return complements;
+}
+
+/**
+ * Replays the release schedule of evaluateTerms.
+ * @return the largest number of complements and products it holds at once, its peak in ciphertexts besides the
+ * decisions and leaves.
+ */
+int LeafPolynomial::getPeakValues() const {
+    std::vector<int> uses = countUses();
+    auto owned = [this](int i) { return operands[i].kind == Kind::COMPLEMENT || operands[i].kind == Kind::PRODUCT; };
+    int live = 0, peak = 0;
+    for (size_t i = 0; i < operands.size(); i++) {
+        const Operand &operand = operands[i];
+        if (uses[i] == 0 || !owned(i))
+            continue;
+        peak = std::max(peak, ++live);
+        if (operand.kind == Kind::PRODUCT) {
+            for (int input : {operand.left, operand.right}) {
+                if (--uses[input] == 0 && owned(input))
+                    live--;
+            }
+        }
+    }
+    return peak;
+}
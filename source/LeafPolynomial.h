@@ -0,0 +1,97 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#ifndef HOMOMORPHICTREEEVALUATOR_LEAFPOLYNOMIAL_H
+#define HOMOMORPHICTREEEVALUATOR_LEAFPOLYNOMIAL_H
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+#include <helib/helib.h>
+#include "DecisionTree.h"
+
+class EncodedModel;
+
+/**
+ * The leaf polynomial of a tree, compiled into a plan of multiplications.
+ *
+ * The polynomial is the sum over every root-to-leaf path of the leaf value times d or 1-d for each decision d on the
+ * path. Multiplying these factors in path order, as calculate_result does, costs as many levels as the tree is deep.
+ * Here each path product is a balanced multiplication tree instead, so a path of L decisions costs
+ * ceil(log2(L + 1)) levels. Every product is split at a power of two, so paths with a common prefix compute the
+ * same left sub-products. Those are computed once, as is each 1-d complement.
+ *
+ * Compiled without leaves, each term is just the indicator of its path, 1 where the query reaches that path's leaf,
+ * for callers that combine the leaf values themselves.
+ */
+class LeafPolynomial {
+public:
+    enum class Kind {
+        DECISION, COMPLEMENT, LEAF, PRODUCT
+    };
+
+    /**
+     * One value of the plan: a decision d, its complement 1-d, a leaf value, or the product of two earlier operands.
+     * Operands only refer to operands before them.
+     */
+    struct Operand {
+        Kind kind;
+        // The node (DECISION, COMPLEMENT) or leaf (LEAF); unused for PRODUCT.
+        int index;
+        int left;
+        int right;
+        // Multiplicative depth above the decisions.
+        int depth;
+    };
+
+    static LeafPolynomial compile(const DecisionTree &tree, bool with_leaves = true);
+
+    helib::Ctxt evaluate(const EncodedModel &model, const std::vector<helib::Ctxt> &decisions) const;
+
+    helib::Ctxt evaluate(const std::vector<helib::Ctxt> &decisions, const std::function<const helib::Ctxt &(int)> &leaf,
+                         const helib::Ctxt &one) const;
+
+    helib::Ctxt evaluate(const std::vector<helib::Ctxt> &decisions, const std::function<const helib::Ctxt &(int)> &leaf,
+                         const helib::Ctxt &one, const std::vector<bool> &stale,
+                         std::vector<std::unique_ptr<helib::Ctxt>> &values) const;
+
+    std::vector<helib::Ctxt> evaluateTerms(const std::vector<helib::Ctxt> &decisions,
+                                           const std::function<const helib::Ctxt &(int)> &leaf,
+                                           const helib::Ctxt &one) const;
+
+    std::vector<bool> dependents(const std::vector<bool> &nodes) const;
+
+    const std::vector<Operand> &getOperands() const;
+
+    const std::vector<int> &getTerms() const;
+
+    const std::vector<int> &getTermLeaves() const;
+
+    int getDepth() const;
+
+    int getMultiplications() const;
+
+    int getComplements() const;
+
+    int getPeakValues() const;
+
+private:
+    int product(const std::vector<int> &factors, size_t begin, size_t end, std::map<std::vector<int>, int> &memo);
+
+    std::vector<int> countUses() const;
+
+    helib::Ctxt sum(const std::function<const helib::Ctxt &(size_t)> &term, const helib::Ctxt &one) const;
+
+    std::vector<Operand> operands;
+    // One operand per root-to-leaf path ending in a non-zero leaf (every path, without leaves); the polynomial is
+    // their sum.
+    std::vector<int> terms;
+    // The leaf each term's path ends in.
+    std::vector<int> term_leaves;
+};
+
+
+#endif //HOMOMORPHICTREEEVALUATOR_LEAFPOLYNOMIAL_H
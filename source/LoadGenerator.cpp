@@ -0,0 +1,262 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#include "LoadGenerator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <random>
+#include <thread>
+#include <sys/resource.h>
+#include "AsyncClient.h"
+#include "CkksEngine.h"
+#include "Client.h"
+#include "EvaluationSession.h"
+#include "ExecutionPolicy.h"
+#include "MemoryBudget.h"
+#include "QueryCoalescer.h"
+#include "SeededCtxt.h"
+#include "TreeEvaluator.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+/**
+ * Sets up keys and a synthetic model, then sends {@code options.queries} queries from {@code options.concurrency}
+ * threads.
+ * @param options the model and the load.
+ * @return the measurements.
+ */
+LoadGenerator::Report LoadGenerator::run(const Options &options) {
+    Report report;
+
+    Clock::time_point setup = Clock::now();
+    std::unique_ptr<COED::Encryptor> encryptor;
+    std::unique_ptr<CkksEngine> ckks;
+    if (options.ckks) {
+        ckks.reset(new CkksEngine(CkksEngine::Parameters()));
+    } else {
+        encryptor.reset(new COED::Encryptor(Client::createEncryptor()));
+    }
+    report.setup_ms = millisecondsSince(setup);
+
+    Clock::time_point encode = Clock::now();
+    DecisionTree tree = DecisionTree::synthetic(options.depth, options.nodes, options.features, options.seed);
+    std::shared_ptr<const EncodedModel> model;
+    std::shared_ptr<const CkksEngine::Model> ckks_model;
+    if (ckks) {
+        ckks_model = ckks->encode(tree);
+    } else {
+        model = EncodedModel::encode(tree, *encryptor->getContext(), *encryptor->getPublicKey());
+    }
+    report.encode_ms = millisecondsSince(encode);
+
+    bool sessions = options.updated_features > 0 && !ckks;
+    std::unique_ptr<QueryCoalescer> coalescer;
+    if (options.coalesce_ms > 0 && !ckks && !sessions) {
+        QueryCoalescer::Options coalescing;
+        coalescing.window_ms = options.coalesce_ms;
+        coalescer.reset(new QueryCoalescer(*encryptor->getContext(), *encryptor->getPublicKey(), coalescing));
+    }
+    std::unique_ptr<COED::SeededCtxt> seeded;
+    if (options.seeded_uploads && !ckks)
+        seeded.reset(new COED::SeededCtxt(*encryptor->getSecretKey()));
+
+    auto decrypt = [&](const helib::Ctxt &result) -> long {
+        const helib::EncryptedArray &ea = *encryptor->getEncryptedArray();
+        std::vector<long> slots(ea.size());
+        ea.decrypt(result, *encryptor->getSecretKey(), slots);
+        return AsyncClient::decode(slots, 1)[0];
+    };
+
+    std::atomic<long> upload_bytes(0);
+    // Encrypts, uploads, evaluates and decrypts one query.
+    auto query = [&](const std::vector<int> &features) -> long {
+        if (ckks) {
+            std::vector<double> values(features.begin(), features.end());
+            helib::Ctxt result = ckks->evaluate(*ckks_model, ckks->encrypt({values}));
+            return std::lround(ckks->decrypt(result, 1)[0]);
+        }
+        helib::Context &context = *encryptor->getContext();
+        helib::PubKey &pubkey = *encryptor->getPublicKey();
+        std::vector<helib::Ctxt> inputs;
+        for (int feature : features) {
+            if (seeded) {
+                int bits[BIT_SIZE];
+                getBin(feature, bits);
+                helib::Ptxt<helib::BGV> ptxt(context);
+                for (int bit = 0; bit < BIT_SIZE; bit++) {
+                    ptxt[bit] = bits[bit];
+                }
+                std::string upload = seeded->encrypt(ptxt);
+                upload_bytes += upload.size();
+                inputs.push_back(COED::SeededCtxt::expand(upload, pubkey));
+            } else {
+                inputs.push_back(TreeEvaluator::getCtxt(3, context, pubkey, feature));
+                upload_bytes += COED::SeededCtxt::uncompressedSize(inputs.back());
+            }
+        }
+        if (coalescer)
+            return decrypt(coalescer->evaluate(std::move(inputs), model));
+        helib::Ctxt result = TreeEvaluator::evaluate_decision_tree(inputs.data(), *model, pubkey, context);
+        return decrypt(result);
+    };
+
+    std::vector<double> latencies(options.queries);
+    std::atomic<long> next(0), errors(0), mismatches(0), comparisons(0), multiplications(0);
+    Clock::time_point start = Clock::now();
+    // CKKS evaluations are not accounted for, and the coalescer accounts for its batches itself.
+    size_t evaluation_bytes = model && !coalescer ? model->evaluationBytes() : 0;
+
+    auto worker = [&]() {
+        std::unique_ptr<EvaluationSession> session;
+        if (sessions) {
+            session.reset(new EvaluationSession(model, *encryptor->getPublicKey(), *encryptor->getContext()));
+        }
+        std::vector<int> features;
+        for (long i = next++; i < options.queries; i = next++) {
+            std::mt19937 random(options.seed + i);
+            std::uniform_int_distribution<int> values(0, 999);
+            // Which features change in a session update.
+            std::vector<int> updated;
+            if (features.empty() || !sessions) {
+                features.resize(options.features);
+                for (int &feature : features) {
+                    feature = values(random);
+                }
+            } else {
+                std::vector<int> order(options.features);
+                for (int f = 0; f < options.features; f++) {
+                    order[f] = f;
+                }
+                std::shuffle(order.begin(), order.end(), random);
+                updated.assign(order.begin(), order.begin() + std::min(options.updated_features, options.features));
+                for (int f : updated) {
+                    features[f] = values(random);
+                }
+            }
+
+            Clock::time_point due = Clock::now();
+            if (options.rate > 0) {
+                due = start + std::chrono::duration_cast<Clock::duration>(
+                        std::chrono::duration<double>(i / options.rate));
+                std::this_thread::sleep_until(due);
+            }
+
+            try {
+                COED::MemoryBudget::Reservation reservation(evaluation_bytes);
+                // A query waiting for its lane of a coalesced batch holds no cores.
+                std::unique_ptr<COED::ExecutionPolicy::Lease> lease;
+                if (!coalescer)
+                    lease.reset(new COED::ExecutionPolicy::Lease());
+                long result;
+                if (!sessions) {
+                    result = query(features);
+                } else if (updated.empty()) {
+                    std::vector<helib::Ctxt> inputs;
+                    for (int feature : features) {
+                        inputs.push_back(TreeEvaluator::getCtxt(3, *encryptor->getContext(),
+                                                                *encryptor->getPublicKey(), feature));
+                    }
+                    result = decrypt(session->evaluate(inputs));
+                } else {
+                    std::map<int, helib::Ctxt> changed;
+                    for (int f : updated) {
+                        changed.emplace(f, TreeEvaluator::getCtxt(3, *encryptor->getContext(),
+                                                                  *encryptor->getPublicKey(), features[f]));
+                    }
+                    result = decrypt(session->update(changed));
+                }
+                if (result != tree.classify(features)) {
+                    mismatches++;
+                }
+            } catch (const std::exception &e) {
+                COED::Util::error(e.what());
+                errors++;
+            }
+            latencies[i] = millisecondsSince(due);
+        }
+        if (session) {
+            comparisons += session->getComparisons();
+            multiplications += session->getMultiplications();
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int i = 0; i < std::max(1, options.concurrency); i++) {
+        workers.emplace_back(worker);
+    }
+    for (std::thread &thread : workers) {
+        thread.join();
+    }
+
+    report.seconds = millisecondsSince(start) / 1000;
+    report.queries = options.queries;
+    report.errors = errors;
+    report.mismatches = mismatches;
+    report.comparisons = comparisons;
+    report.multiplications = multiplications;
+    report.batches = coalescer ? coalescer->getBatches() : 0;
+    report.upload_bytes = options.queries > 0 ? (double) upload_bytes / options.queries : 0;
+    report.queries_per_second = report.seconds > 0 ? report.queries / report.seconds : 0;
+    std::sort(latencies.begin(), latencies.end());
+    report.p50_ms = LoadGenerator::percentile(latencies, 0.5);
+    report.p99_ms = LoadGenerator::percentile(latencies, 0.99);
+    report.p999_ms = LoadGenerator::percentile(latencies, 0.999);
+    report.max_ms = latencies.empty() ? 0 : latencies.back();
+
+    struct rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    // Kilobytes on Linux.
+    report.peak_rss_kb = usage.ru_maxrss;
+    report.peak_ctxt_bytes = COED::MemoryBudget::getPeakBytes();
+    return report;
+}
+
+void LoadGenerator::print(const Report &report, std::ostream &out) {
+    out << "queries:            " << report.queries << " (" << report.errors << " errors, " << report.mismatches
+        << " wrong results)" << std::endl;
+    out << "key setup:          " << report.setup_ms << " ms" << std::endl;
+    out << "model encoding:     " << report.encode_ms << " ms" << std::endl;
+    out << "elapsed:            " << report.seconds << " s" << std::endl;
+    out << "throughput:         " << report.queries_per_second << " queries/s" << std::endl;
+    out << "latency p50:        " << report.p50_ms << " ms" << std::endl;
+    out << "latency p99:        " << report.p99_ms << " ms" << std::endl;
+    out << "latency p99.9:      " << report.p999_ms << " ms" << std::endl;
+    out << "latency max:        " << report.max_ms << " ms" << std::endl;
+    if (report.upload_bytes > 0) {
+        out << "upload per query:   " << report.upload_bytes / 1024 << " KiB" << std::endl;
+    }
+    out << "peak RSS:           " << report.peak_rss_kb / 1024.0 << " MiB" << std::endl;
+    if (report.peak_ctxt_bytes > 0) {
+        out << "peak in flight:     " << report.peak_ctxt_bytes / 1048576.0 << " MiB of ciphertexts" << std::endl;
+    }
+    if (report.batches > 0) {
+        out << "coalesced:          " << report.batches << " evaluations, "
+            << (double) report.queries / report.batches << " queries each" << std::endl;
+    }
+    if (report.comparisons > 0) {
+        out << "session work:       " << report.comparisons << " comparisons, " << report.multiplications
+            << " multiplications" << std::endl;
+    }
+}
+
+/**
+ * @param sorted samples in ascending order.
+ * @param fraction between 0 and 1.
+ * @return the nearest-rank percentile, or 0 without samples.
+ */
+double LoadGenerator::percentile(const std::vector<double> &sorted, double fraction) {
+    if (sorted.empty())
+        return 0;
+    long rank = (long) std::ceil(fraction * sorted.size());
+    return sorted[std::max(1L, rank) - 1];
+}
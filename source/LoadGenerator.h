@@ -0,0 +1,85 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#ifndef HOMOMORPHICTREEEVALUATOR_LOADGENERATOR_H
+#define HOMOMORPHICTREEEVALUATOR_LOADGENERATOR_H
+
+#include <iostream>
+#include <vector>
+
+/**
+ * Drives the whole query path under load: key setup as in Client::createEncryptor, encryption of random queries,
+ * TreeEvaluator::evaluate_decision_tree on a synthetic model, and decryption. Each result is checked against the tree
+ * evaluated in the clear. The same load can be run on CkksEngine instead.
+ *
+ * With a request rate, query i is due at i / rate seconds and its latency counts from then, so time spent waiting for a
+ * free worker is part of it. Without one, every worker sends its next query as soon as the last one returned.
+ *
+ * With seeded uploads, queries are encrypted under the secret key and sent in the SeededCtxt format, which the server
+ * side expands before evaluating; the report gives the upload size either way.
+ *
+ * With updated features, each worker plays one client of an EvaluationSession: its first query sends a full feature
+ * vector, and every later one changes that many random features of the previous vector and sends only those.
+ *
+ * With a coalescing window, each worker plays a client sending one query at a time to a server that merges
+ * concurrent queries into lanes with QueryCoalescer; the report gives the mean number of queries per evaluation. It
+ * applies to BGV queries sent in full.
+ */
+class LoadGenerator {
+public:
+    struct Options {
+        // The synthetic model, see DecisionTree::synthetic.
+        int depth = 3;
+        int nodes = 7;
+        int features = 3;
+        unsigned seed = 1;
+        // Queries in flight at once, and queries per second; 0 sends queries back to back.
+        int concurrency = 1;
+        double rate = 0;
+        long queries = 100;
+        // Evaluate with CkksEngine instead of the BGV bit circuits.
+        bool ckks = false;
+        // Features changed per query in an EvaluationSession; 0 sends every query in full.
+        int updated_features = 0;
+        // Send queries as SeededCtxt instead of Ctxt::write output.
+        bool seeded_uploads = false;
+        // How long a query waits for others to share its evaluation, see QueryCoalescer; 0 evaluates each alone.
+        double coalesce_ms = 0;
+    };
+
+    struct Report {
+        long queries = 0;
+        long errors = 0;
+        // Results that differ from the tree evaluated in the clear.
+        long mismatches = 0;
+        double setup_ms = 0;
+        double encode_ms = 0;
+        double seconds = 0;
+        double queries_per_second = 0;
+        double p50_ms = 0;
+        double p99_ms = 0;
+        double p999_ms = 0;
+        double max_ms = 0;
+        long peak_rss_kb = 0;
+        // The most ciphertext memory the evaluations in flight reserved at once, see COED::MemoryBudget.
+        size_t peak_ctxt_bytes = 0;
+        // Mean bytes a query uploads, without sessions.
+        double upload_bytes = 0;
+        // Work done by the sessions, with updated features.
+        long comparisons = 0;
+        long multiplications = 0;
+        // Evaluations run by the QueryCoalescer, with a coalescing window.
+        long batches = 0;
+    };
+
+    static Report run(const Options &options);
+
+    static void print(const Report &report, std::ostream &out);
+
+    static double percentile(const std::vector<double> &sorted, double fraction);
+};
+
+
+#endif //HOMOMORPHICTREEEVALUATOR_LOADGENERATOR_H
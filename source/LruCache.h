@@ -0,0 +1,175 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#ifndef HOMOMORPHICTREEEVALUATOR_LRUCACHE_H
+#define HOMOMORPHICTREEEVALUATOR_LRUCACHE_H
+
+#include <functional>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "Util.h"
+
+namespace COED {
+    /**
+     * A cache of values that are expensive to make, such as encoded models or loaded keys, under a memory budget.
+     *
+     * get() makes a value on first use and keeps it until the cached values together exceed the budget, when the least
+     * recently used ones are dropped and made again when next requested. A caller holding a dropped value keeps it
+     * alive until it lets go. Concurrent requests for a value that is being made wait for that one load, which runs
+     * without the lock held so that requests for cached values are not held up.
+     */
+    template<typename Value>
+    class LruCache {
+    public:
+        /**
+         * @param description what a value is, for the log, e.g. "encoded model".
+         * @param memory_budget the bytes cached values may take together. The most recently used value is kept even if
+         * it alone exceeds the budget.
+         * @param bytes the size of a value.
+         */
+        LruCache(const std::string &description, size_t memory_budget, std::function<size_t(const Value &)> bytes)
+                : description(description), memory_budget(memory_budget), bytes(std::move(bytes)) {}
+
+        /**
+         * Returns the value cached under {@code key}, or makes it with {@code load}.
+         * @param key the key.
+         * @param load makes the value, as a std::shared_ptr<Value>; called without the lock held. What it throws is
+         * thrown to every request waiting for it, and nothing is cached.
+         * @return the value.
+         */
+        template<typename Load>
+        std::shared_ptr<Value> get(const std::string &key, Load load) {
+            std::unique_lock<std::mutex> lock(mutex);
+            Entry &entry = entries[key];
+            if (entry.value) {
+                hits++;
+                lru.splice(lru.begin(), lru, entry.position);
+                return entry.value;
+            }
+            misses++;
+            if (entry.loading.valid()) {
+                std::shared_future<std::shared_ptr<Value>> loading = entry.loading;
+                lock.unlock();
+                return loading.get();
+            }
+
+            std::promise<std::shared_ptr<Value>> promise;
+            entry.loading = promise.get_future().share();
+            long generation = entry.generation = ++generations;
+            lock.unlock();
+
+            std::shared_ptr<Value> value;
+            size_t size;
+            try {
+                value = load();
+                size = bytes(*value);
+            } catch (...) {
+                promise.set_exception(std::current_exception());
+                lock.lock();
+                auto it = entries.find(key);
+                if (it != entries.end() && it->second.generation == generation)
+                    entries.erase(it);
+                throw;
+            }
+
+            lock.lock();
+            auto it = entries.find(key);
+            // The key may have been erased meanwhile; then the value only serves the requests waiting for it.
+            if (it != entries.end() && it->second.generation == generation) {
+                Entry &loaded = it->second;
+                loaded.loading = {};
+                loaded.value = value;
+                loaded.bytes = size;
+                lru.push_front(key);
+                loaded.position = lru.begin();
+                cached_bytes += size;
+                evict(key);
+            }
+            lock.unlock();
+            promise.set_value(value);
+            return value;
+        }
+
+        /**
+         * Drops the value cached under {@code key}. A load of it in progress still serves the requests waiting for it,
+         * but its value is not cached, so later requests load it again.
+         * @param key the key.
+         * @return false if nothing was cached or loading under {@code key}.
+         */
+        bool erase(const std::string &key) {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = entries.find(key);
+            if (it == entries.end())
+                return false;
+            if (it->second.value) {
+                cached_bytes -= it->second.bytes;
+                lru.erase(it->second.position);
+            }
+            entries.erase(it);
+            return true;
+        }
+
+        size_t getCachedBytes() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return cached_bytes;
+        }
+
+        long getHits() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return hits;
+        }
+
+        long getMisses() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return misses;
+        }
+
+    private:
+        struct Entry {
+            std::shared_ptr<Value> value;
+            // Set while the value is being loaded.
+            std::shared_future<std::shared_ptr<Value>> loading;
+            size_t bytes = 0;
+            // Position in lru while cached.
+            std::list<std::string>::iterator position;
+            // Identifies the load that owns the entry.
+            long generation = 0;
+        };
+
+        /**
+         * Drops least recently used values until the cache fits the budget, never dropping {@code keep}. Called with
+         * the lock held.
+         * @param keep the key just cached.
+         */
+        void evict(const std::string &keep) {
+            while (cached_bytes > memory_budget && !lru.empty() && lru.back() != keep) {
+                auto it = entries.find(lru.back());
+                COED::Util::info("Evicting " + description + " " + it->first);
+                cached_bytes -= it->second.bytes;
+                lru.pop_back();
+                entries.erase(it);
+            }
+        }
+
+        std::string description;
+        size_t memory_budget;
+        std::function<size_t(const Value &)> bytes;
+
+        mutable std::mutex mutex;
+        std::map<std::string, Entry> entries;
+        // Cached keys, most recently used first.
+        std::list<std::string> lru;
+        size_t cached_bytes = 0;
+        long generations = 0;
+        long hits = 0;
+        long misses = 0;
+    };
+}
+
+#endif //HOMOMORPHICTREEEVALUATOR_LRUCACHE_H
@@ -0,0 +1,87 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#include "MappedFile.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Maps the whole of {@code path}. The descriptor is closed right away; the mapping stays valid until destruction.
+ * @param path the file to map.
+ */
+COED::MappedFile::MappedFile(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("cannot open " + path);
+    struct stat st{};
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error("cannot stat " + path);
+    }
+    length = st.st_size;
+    if (length > 0) {
+        address = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        if (address == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("cannot map " + path);
+        }
+        // Keys are parsed front to back.
+        madvise(address, length, MADV_SEQUENTIAL);
+    }
+    close(fd);
+
+    input.reset(new Stream(data(), length));
+}
+
+COED::MappedFile::~MappedFile() {
+    if (length > 0)
+        munmap(address, length);
+}
+
+const char *COED::MappedFile::data() const {
+    return static_cast<const char *>(address);
+}
+
+size_t COED::MappedFile::size() const {
+    return length;
+}
+
+bool COED::MappedFile::startsWith(const std::string &prefix) const {
+    return length >= prefix.size() && std::memcmp(address, prefix.data(), prefix.size()) == 0;
+}
+
+/**
+ * @return a stream over the mapped bytes, positioned where the last read through it stopped.
+ */
+std::istream &COED::MappedFile::stream() {
+    return *input;
+}
+
+COED::MappedFile::Stream::Stream(const char *begin, size_t size) : Buffer(begin, size), std::istream(this) {
+}
+
+// The get area is the mapping itself; the stream never writes to it.
+COED::MappedFile::Buffer::Buffer(const char *begin, size_t size) {
+    char *first = const_cast<char *>(begin);
+    setg(first, first, first + size);
+}
+
+std::streambuf::pos_type COED::MappedFile::Buffer::seekoff(off_type offset, std::ios_base::seekdir direction,
+                                                           std::ios_base::openmode) {
+    char *base = direction == std::ios_base::beg ? eback() : direction == std::ios_base::cur ? gptr() : egptr();
+    if (base + offset < eback() || base + offset > egptr())
+        return pos_type(off_type(-1));
+    setg(eback(), base + offset, egptr());
+    return pos_type(gptr() - eback());
+}
+
+std::streambuf::pos_type COED::MappedFile::Buffer::seekpos(pos_type position, std::ios_base::openmode mode) {
+    return seekoff(off_type(position), std::ios_base::beg, mode);
+}
@@ -0,0 +1,61 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#ifndef HOMOMORPHICTREEEVALUATOR_MAPPEDFILE_H
+#define HOMOMORPHICTREEEVALUATOR_MAPPEDFILE_H
+
+#include <istream>
+#include <memory>
+#include <streambuf>
+#include <string>
+
+namespace COED {
+    /**
+     * A file mapped read-only into memory. Every process mapping the same file shares the same page cache pages, and
+     * stream() reads straight from them without copying the file into a buffer first.
+     */
+    class MappedFile {
+    private:
+        struct Buffer : public std::streambuf {
+            Buffer(const char *begin, size_t size);
+
+            pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode) override;
+
+            pos_type seekpos(pos_type position, std::ios_base::openmode mode) override;
+        };
+
+    public:
+        /**
+         * An input stream over a range of mapped bytes. Each thread reading the same mapping should use its own.
+         */
+        class Stream : private Buffer, public std::istream {
+        public:
+            Stream(const char *begin, size_t size);
+        };
+
+        explicit MappedFile(const std::string &path);
+
+        MappedFile(const MappedFile &) = delete;
+
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        ~MappedFile();
+
+        const char *data() const;
+
+        size_t size() const;
+
+        bool startsWith(const std::string &prefix) const;
+
+        std::istream &stream();
+
+    private:
+        void *address = nullptr;
+        size_t length = 0;
+        std::unique_ptr<Stream> input;
+    };
+}
+
+#endif //HOMOMORPHICTREEEVALUATOR_MAPPEDFILE_H
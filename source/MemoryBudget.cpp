@@ -0,0 +1,85 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#include "MemoryBudget.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include "Util.h"
+
+static std::mutex budget_mutex;
+static std::condition_variable budget_freed;
+static size_t budget_cap = std::numeric_limits<size_t>::max();
+static size_t live_bytes = 0;
+static size_t peak_bytes = 0;
+
+/**
+ * Sets the cap for the rest of the process.
+ * @param cap the bytes the ciphertexts of running evaluations may take together.
+ */
+void COED::MemoryBudget::configure(size_t cap) {
+    if (cap == 0)
+        throw std::invalid_argument("a memory cap must be positive");
+    std::lock_guard<std::mutex> lock(budget_mutex);
+    budget_cap = cap;
+    budget_freed.notify_all();
+}
+
+size_t COED::MemoryBudget::getCap() {
+    std::lock_guard<std::mutex> lock(budget_mutex);
+    return budget_cap;
+}
+
+/**
+ * @return the bytes reserved by the evaluations running now.
+ */
+size_t COED::MemoryBudget::getLiveBytes() {
+    std::lock_guard<std::mutex> lock(budget_mutex);
+    return live_bytes;
+}
+
+/**
+ * @return the most bytes ever reserved at once.
+ */
+size_t COED::MemoryBudget::getPeakBytes() {
+    std::lock_guard<std::mutex> lock(budget_mutex);
+    return peak_bytes;
+}
+
+/**
+ * @param bytes the peak of one evaluation.
+ * @param requested the number of evaluations a pool would like to run at once.
+ * @return how many of them fit in the cap, at least one.
+ */
+int COED::MemoryBudget::concurrency(size_t bytes, int requested) {
+    size_t cap = COED::MemoryBudget::getCap();
+    if (bytes == 0)
+        return requested;
+    return (int) std::max<size_t>(1, std::min<size_t>(requested, cap / bytes));
+}
+
+/**
+ * Waits until {@code bytes} fit under the cap next to the evaluations running now, or until none is running.
+ * @param bytes the estimated peak of the evaluation.
+ */
+COED::MemoryBudget::Reservation::Reservation(size_t bytes) : bytes(bytes) {
+    std::unique_lock<std::mutex> lock(budget_mutex);
+    if (live_bytes > 0 && live_bytes + bytes > budget_cap) {
+        COED::Util::info("Waiting for " + std::to_string(bytes) + " bytes of ciphertext memory");
+        budget_freed.wait(lock, [&] { return live_bytes == 0 || live_bytes + bytes <= budget_cap; });
+    }
+    live_bytes += bytes;
+    peak_bytes = std::max(peak_bytes, live_bytes);
+}
+
+COED::MemoryBudget::Reservation::~Reservation() {
+    std::lock_guard<std::mutex> lock(budget_mutex);
+    live_bytes -= bytes;
+    budget_freed.notify_all();
+}
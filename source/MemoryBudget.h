@@ -0,0 +1,55 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#ifndef HOMOMORPHICTREEEVALUATOR_MEMORYBUDGET_H
+#define HOMOMORPHICTREEEVALUATOR_MEMORYBUDGET_H
+
+#include <cstddef>
+
+namespace COED {
+    /**
+     * Accounts for the ciphertexts that evaluations in flight hold, and keeps them under a cap.
+     *
+     * The peak memory of a busy server is dominated by the temporaries of the evaluations running at the moment (the
+     * sum and carry of every comparison, the products of the leaf polynomial), not by the models. Each evaluation
+     * takes a Reservation of its estimated peak, e.g. EncodedModel::evaluationBytes, for as long as it runs. Once a
+     * cap is configured, a reservation that does not fit waits until enough running evaluations finish; one
+     * evaluation is always let through, however large, so that work never stalls. Pools of workers can also be sized
+     * up front with concurrency, so that they do not wait at all.
+     *
+     * Without a cap, reservations only count.
+     */
+    class MemoryBudget {
+    public:
+        static void configure(size_t cap);
+
+        static size_t getCap();
+
+        static size_t getLiveBytes();
+
+        static size_t getPeakBytes();
+
+        static int concurrency(size_t bytes, int requested);
+
+        /**
+         * The bytes of one running evaluation.
+         */
+        class Reservation {
+        public:
+            explicit Reservation(size_t bytes);
+
+            ~Reservation();
+
+            Reservation(const Reservation &) = delete;
+
+            Reservation &operator=(const Reservation &) = delete;
+
+        private:
+            size_t bytes;
+        };
+    };
+}
+
+#endif //HOMOMORPHICTREEEVALUATOR_MEMORYBUDGET_H
@@ -0,0 +1,124 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#include "ModelRegistry.h"
+
+#include <dirent.h>
+#include <stdexcept>
+#include "Util.h"
+
+/**
+ * @param context the context shared by every model.
+ * @param pubkey the client's public key, shared by every model.
+ * @param memory_budget the bytes encoded models may take together, see EncodedModel::footprint. The most recently
+ * used model is kept even if it alone exceeds the budget.
+ */
+ModelRegistry::ModelRegistry(helib::Context &context, helib::PubKey &pubkey, size_t memory_budget)
+        : context(context), pubkey(pubkey),
+          encoded("encoded model", memory_budget, [](const EncodedModel &model) { return model.footprint(); }) {}
+
+/**
+ * Registers {@code tree} under {@code id}, replacing any model registered under it. Nothing is encoded until the model
+ * is requested.
+ * @param id the model ID requests name.
+ * @param tree the plaintext model.
+ */
+void ModelRegistry::add(const std::string &id, const DecisionTree &tree) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        trees[id] = std::make_shared<const DecisionTree>(tree);
+    }
+    // After the tree is replaced, so that an encoding that may have read the old tree is not cached.
+    encoded.erase(id);
+}
+/**
+ * Registers every {@code .tree} file of {@code directory} under its file name without the extension. Files that cannot
+ * be loaded are reported and skipped.
+ * @param directory the directory to scan.
+ * @return the number of models registered.
+ */
+int ModelRegistry::load(const std::string &directory) {
+    DIR *dir = opendir(directory.c_str());
+    if (dir == nullptr)
+        throw std::runtime_error("cannot open model directory " + directory);
+
+    const std::string extension = ".tree";
+    int loaded = 0;
+    for (struct dirent *file = readdir(dir); file != nullptr; file = readdir(dir)) {
+        std::string name = file->d_name;
+        if (name.size() <= extension.size() || name.compare(name.size() - extension.size(), extension.size(),
+                                                            extension) != 0)
+            continue;
+        try {
+            add(name.substr(0, name.size() - extension.size()), DecisionTree::load(directory + "/" + name));
+            loaded++;
+        } catch (const std::exception &e) {
+            COED::Util::error("Skipping model " + name + ": " + e.what());
+        }
+    }
+    closedir(dir);
+    return loaded;
+}
+
+/**
+ * @param id a model ID.
+ * @return false if no model was registered under {@code id}.
+ */
+bool ModelRegistry::remove(const std::string &id) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (trees.erase(id) == 0)
+            return false;
+    }
+    encoded.erase(id);
+    return true;
+}
+
+/**
+ * Returns the encoded model registered under {@code id}, encoding it first if it is not cached.
+ * @param id a model ID.
+ * @return the encoded model. The caller keeps it alive for as long as it holds on to it.
+ */
+std::shared_ptr<const EncodedModel> ModelRegistry::get(const std::string &id) {
+    getTree(id);
+    // The tree is read again by the encoding itself, which only starts once the cache has noted it; a replacement
+    // between the two is then caught by the erase in add or remove.
+    return encoded.get(id, [this, &id]() -> std::shared_ptr<const EncodedModel> {
+        return EncodedModel::encode(*getTree(id), context, pubkey);
+    });
+}
+
+/**
+ * @param id a model ID.
+ * @return the plaintext tree registered under {@code id}, e.g. to learn its feature count without encoding it.
+ */
+std::shared_ptr<const DecisionTree> ModelRegistry::getTree(const std::string &id) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = trees.find(id);
+    if (it == trees.end())
+        throw std::out_of_range("no model " + id);
+    return it->second;
+}
+
+std::vector<std::string> ModelRegistry::ids() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::string> result;
+    for (const auto &tree : trees) {
+        result.push_back(tree.first);
+    }
+    return result;
+}
+
+size_t ModelRegistry::getCachedBytes() const {
+    return encoded.getCachedBytes();
+}
+
+long ModelRegistry::getHits() const {
+    return encoded.getHits();
+}
+
+long ModelRegistry::getMisses() const {
+    return encoded.getMisses();
+}
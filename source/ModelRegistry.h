@@ -0,0 +1,58 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#ifndef HOMOMORPHICTREEEVALUATOR_MODELREGISTRY_H
+#define HOMOMORPHICTREEEVALUATOR_MODELREGISTRY_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "EncodedModel.h"
+#include "LruCache.h"
+
+/**
+ * Serves many models from one process. Every model is registered under an ID as a plaintext tree, and all of them are
+ * encoded against the same context and public key, so key material exists once however many models there are.
+ *
+ * Encoded models are cached in a COED::LruCache: get() encodes a model on first use and keeps it until the encoded
+ * models together exceed the memory budget, when the least recently used ones are dropped and encoded again when next
+ * requested. A request holding a dropped model keeps it alive until it finishes. Concurrent requests for a model that
+ * is being encoded wait for that one encoding.
+ */
+class ModelRegistry {
+public:
+    ModelRegistry(helib::Context &context, helib::PubKey &pubkey, size_t memory_budget);
+
+    void add(const std::string &id, const DecisionTree &tree);
+
+    int load(const std::string &directory);
+
+    bool remove(const std::string &id);
+
+    std::shared_ptr<const EncodedModel> get(const std::string &id);
+
+    std::shared_ptr<const DecisionTree> getTree(const std::string &id) const;
+
+    std::vector<std::string> ids() const;
+
+    size_t getCachedBytes() const;
+
+    long getHits() const;
+
+    long getMisses() const;
+
+private:
+    helib::Context &context;
+    helib::PubKey &pubkey;
+
+    mutable std::mutex mutex;
+    std::map<std::string, std::shared_ptr<const DecisionTree>> trees;
+    COED::LruCache<const EncodedModel> encoded;
+};
+
+
+#endif //HOMOMORPHICTREEEVALUATOR_MODELREGISTRY_H
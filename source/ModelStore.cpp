@@ -0,0 +1,92 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#include "ModelStore.h"
+
+#include <sys/stat.h>
+#include "Util.h"
+
+ModelStore::ModelStore(helib::Context &context, helib::PubKey &pubkey, const DecisionTree &initial)
+        : context(context), pubkey(pubkey), live(EncodedModel::encode(initial, context, pubkey)) {}
+
+ModelStore::~ModelStore() {
+    {
+        std::lock_guard<std::mutex> lock(watcher_mutex);
+        stopping = true;
+    }
+    watcher_cv.notify_all();
+    if (watcher.joinable())
+        watcher.join();
+}
+
+/**
+ * @return the model new queries should be evaluated with. The caller keeps it alive for as long as it holds on to it.
+ */
+std::shared_ptr<const EncodedModel> ModelStore::current() const {
+    return std::atomic_load(&live);
+}
+
+/**
+ * @return the number of models published since construction.
+ */
+long ModelStore::getVersion() const {
+    return version.load();
+}
+
+/**
+ * Loads and encodes the model at {@code path} on the calling thread, then makes it the live model. The live model is
+ * left untouched if the file cannot be loaded.
+ * @param path the path of the model file.
+ * @return true if the new model was published.
+ */
+bool ModelStore::reload(const std::string &path) {
+    std::lock_guard<std::mutex> lock(reload_mutex);
+    std::shared_ptr<const EncodedModel> next;
+    try {
+        next = EncodedModel::encode(DecisionTree::load(path), context, pubkey);
+    } catch (const std::exception &e) {
+        COED::Util::error("Keeping current model, could not load " + path + ": " + e.what());
+        return false;
+    }
+    std::atomic_store(&live, next);
+    version++;
+    COED::Util::info("Loaded model " + path + " (version " + std::to_string(version.load()) + ")");
+    return true;
+}
+
+/**
+ * Same as reload, but runs on a background thread. The store must outlive the returned future.
+ * @param path the path of the model file.
+ * @return a future that becomes true once the new model is live.
+ */
+std::future<bool> ModelStore::reload_async(const std::string &path) {
+    return std::async(std::launch::async, [this, path] { return reload(path); });
+}
+
+/**
+ * Starts a background thread that reloads {@code path} whenever its modification time changes. Only one file can be
+ * watched; the watcher stops when the store is destroyed.
+ * @param path the path of the model file.
+ * @param interval how often to check the file.
+ */
+void ModelStore::watch(const std::string &path, std::chrono::milliseconds interval) {
+    if (watcher.joinable())
+        return;
+
+    watcher = std::thread([this, path, interval] {
+        struct stat st{};
+        time_t last_modified = stat(path.c_str(), &st) == 0 ? st.st_mtime : 0;
+
+        std::unique_lock<std::mutex> lock(watcher_mutex);
+        while (!watcher_cv.wait_for(lock, interval, [this] { return stopping; })) {
+            if (stat(path.c_str(), &st) != 0 || st.st_mtime == last_modified)
+                continue;
+            last_modified = st.st_mtime;
+            lock.unlock();
+            reload(path);
+            lock.lock();
+        }
+    });
+}
@@ -0,0 +1,57 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#ifndef HOMOMORPHICTREEEVALUATOR_MODELSTORE_H
+#define HOMOMORPHICTREEEVALUATOR_MODELSTORE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "EncodedModel.h"
+
+/**
+ * Holds the live model and swaps in new ones without stopping the evaluator or touching the keys. A replacement is
+ * loaded and encoded against the existing context on a background thread and then published with a single atomic
+ * store. Queries take a reference with current() when they start, so in-flight queries finish on the model they began
+ * with and the old model is freed when the last of them drops its reference.
+ */
+class ModelStore {
+public:
+    ModelStore(helib::Context &context, helib::PubKey &pubkey, const DecisionTree &initial);
+
+    ~ModelStore();
+
+    std::shared_ptr<const EncodedModel> current() const;
+
+    long getVersion() const;
+
+    bool reload(const std::string &path);
+
+    std::future<bool> reload_async(const std::string &path);
+
+    void watch(const std::string &path, std::chrono::milliseconds interval);
+
+private:
+    helib::Context &context;
+    helib::PubKey &pubkey;
+
+    std::shared_ptr<const EncodedModel> live;
+    std::atomic<long> version{0};
+    // Serializes reloads so that two overlapping reloads cannot publish out of order.
+    std::mutex reload_mutex;
+
+    std::thread watcher;
+    std::mutex watcher_mutex;
+    std::condition_variable watcher_cv;
+    bool stopping = false;
+};
+
+
+#endif //HOMOMORPHICTREEEVALUATOR_MODELSTORE_H
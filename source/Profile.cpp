@@ -0,0 +1,244 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#include "Profile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <linux/perf_event.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+#include <NTL/BasicThreadPool.h>
+#include "Trace.h"
+#include "Util.h"
+
+struct PhaseTotals {
+    long calls = 0;
+    COED::Profile::Counters counters;
+};
+
+// The phases one thread ran. The mutex is only contended while a profile is printed.
+struct ProfileBuffer {
+    std::mutex mutex;
+    std::map<std::string, PhaseTotals> phases;
+};
+
+// The counter group of one thread, cycles leading; closed when the thread exits.
+struct ThreadCounters {
+    int fds[3] = {-1, -1, -1};
+    bool opened = false;
+
+    ~ThreadCounters() {
+        for (int fd : fds) {
+            if (fd >= 0)
+                close(fd);
+        }
+    }
+};
+
+static std::atomic<bool> profile_active(false);
+static std::atomic<bool> counters_available(false);
+static std::atomic<bool> counters_failed(false);
+// The largest NTL pool, counting the calling thread, that a recorded span could have run on.
+static std::atomic<long> widest_pool(1);
+static std::mutex profile_buffers_mutex;
+// Buffers outlive their threads, so that phases of worker threads that have exited are still printed.
+static std::vector<std::shared_ptr<ProfileBuffer>> profile_buffers;
+
+static ProfileBuffer &threadBuffer() {
+    thread_local std::shared_ptr<ProfileBuffer> buffer;
+    if (!buffer) {
+        buffer = std::make_shared<ProfileBuffer>();
+        std::lock_guard<std::mutex> lock(profile_buffers_mutex);
+        profile_buffers.push_back(buffer);
+    }
+    return *buffer;
+}
+
+/**
+ * Opens a user-space hardware counter of the calling thread, on whichever CPU it runs.
+ * @param config a PERF_COUNT_HW_* event.
+ * @param group the file descriptor of the group leader, or -1 to open a leader.
+ * @return the file descriptor, or -1.
+ */
+static int openCounter(uint64_t config, int group) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int) syscall(__NR_perf_event_open, &attr, 0, -1, group, PERF_FLAG_FD_CLOEXEC);
+}
+
+/**
+ * @return the calling thread's counters, opened on the first call; nullptr if they cannot be opened.
+ */
+static ThreadCounters *threadCounters() {
+    thread_local ThreadCounters counters;
+    if (!counters.opened) {
+        counters.opened = true;
+        const uint64_t events[3] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES};
+        for (int i = 0; i < 3; i++) {
+            counters.fds[i] = openCounter(events[i], counters.fds[0]);
+            if (counters.fds[i] < 0) {
+                if (!counters_failed.exchange(true))
+                    COED::Util::error(std::string("Cannot open hardware counters: ") + std::strerror(errno) +
+                                      "; only calls are profiled");
+                break;
+            }
+        }
+        if (counters.fds[2] >= 0)
+            counters_available = true;
+    }
+    return counters.fds[2] >= 0 ? &counters : nullptr;
+}
+
+/**
+ * Starts profiling.
+ * @param path the file the profile is written to when it ends.
+ */
+COED::Profile::Profile(const std::string &path) : path(path) {
+    if (profile_active)
+        throw std::logic_error("a profile is already being recorded");
+    if (!COED::Trace::isCompiledIn())
+        COED::Util::error("Tracing is not compiled in; rebuild with -DHTE_ENABLE_TRACING=ON to profile into " + path);
+    {
+        std::lock_guard<std::mutex> lock(profile_buffers_mutex);
+        for (const std::shared_ptr<ProfileBuffer> &buffer : profile_buffers) {
+            std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+            buffer->phases.clear();
+        }
+    }
+    widest_pool = 1;
+    profile_active = true;
+}
+
+/**
+ * Stops profiling and writes the profile.
+ */
+COED::Profile::~Profile() {
+    profile_active = false;
+    std::ofstream out(path);
+    print(out);
+    if (out)
+        COED::Util::info("Profile written to " + path);
+    else
+        COED::Util::error("cannot write profile " + path);
+}
+
+bool COED::Profile::isActive() {
+    return profile_active;
+}
+
+/**
+ * Reads the calling thread's counters. Counts are scaled up for the time the kernel had to multiplex the counters
+ * with other events.
+ * @return the counts since the thread's counters were opened, or zeros if they cannot be.
+ */
+COED::Profile::Counters COED::Profile::read() {
+    Counters counters;
+    ThreadCounters *thread = threadCounters();
+    if (thread == nullptr)
+        return counters;
+    // nr, time_enabled, time_running, then one value per counter in the order they were opened.
+    uint64_t values[6];
+    if (::read(thread->fds[0], values, sizeof(values)) != (ssize_t) sizeof(values) || values[0] != 3 ||
+        values[2] == 0)
+        return counters;
+    double scale = (double) values[1] / values[2];
+    counters.cycles = (uint64_t) (values[3] * scale);
+    counters.instructions = (uint64_t) (values[4] * scale);
+    counters.cache_misses = (uint64_t) (values[5] * scale);
+    return counters;
+}
+
+/**
+ * Adds one run of a phase to the profile. Called by Trace::Span.
+ * @param phase the name of the span.
+ * @param begin the counters when the phase began.
+ * @param end the counters when it ended, on the same thread.
+ */
+void COED::Profile::record(const char *phase, const Counters &begin, const Counters &end) {
+    ProfileBuffer &buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    PhaseTotals &totals = buffer.phases[phase];
+    totals.calls++;
+    // Scaling can make a later reading smaller; such runs count as zero.
+    totals.counters.cycles += end.cycles > begin.cycles ? end.cycles - begin.cycles : 0;
+    totals.counters.instructions += end.instructions > begin.instructions ? end.instructions - begin.instructions : 0;
+    totals.counters.cache_misses += end.cache_misses > begin.cache_misses ? end.cache_misses - begin.cache_misses : 0;
+
+    long pool = NTL::AvailableThreads();
+    for (long widest = widest_pool; pool > widest && !widest_pool.compare_exchange_weak(widest, pool);) {
+    }
+}
+
+/**
+ * Prints one line per phase, summed over all threads, with the most cycles first. If spans ran with NTL pool threads,
+ * which the counters miss, a first line says so.
+ */
+void COED::Profile::print(std::ostream &out) const {
+    std::map<std::string, PhaseTotals> phases;
+    {
+        std::lock_guard<std::mutex> lock(profile_buffers_mutex);
+        for (const std::shared_ptr<ProfileBuffer> &buffer : profile_buffers) {
+            std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+            for (const auto &phase : buffer->phases) {
+                PhaseTotals &totals = phases[phase.first];
+                totals.calls += phase.second.calls;
+                totals.counters.cycles += phase.second.counters.cycles;
+                totals.counters.instructions += phase.second.counters.instructions;
+                totals.counters.cache_misses += phase.second.counters.cache_misses;
+            }
+        }
+    }
+    std::vector<std::pair<std::string, PhaseTotals>> sorted(phases.begin(), phases.end());
+    std::sort(sorted.begin(), sorted.end(), [](const std::pair<std::string, PhaseTotals> &a,
+                                               const std::pair<std::string, PhaseTotals> &b) {
+        return a.second.counters.cycles != b.second.counters.cycles
+               ? a.second.counters.cycles > b.second.counters.cycles : a.second.calls > b.second.calls;
+    });
+
+    bool counted = counters_available;
+    if (counted && widest_pool > 1) {
+        std::string note = "counts cover only the thread that ran each span, not the up to " +
+                           std::to_string(widest_pool - 1) + " NTL pool threads that helped it; " +
+                           "profile with --threading static --cores 1 to count all the work";
+        COED::Util::error("Profile: " + note);
+        out << "# " << note << std::endl;
+    }
+    out << std::left << std::setw(20) << "phase" << std::right << std::setw(10) << "calls";
+    if (counted) {
+        out << std::setw(16) << "Mcycles" << std::setw(16) << "Minstructions" << std::setw(8) << "IPC"
+            << std::setw(14) << "LLC misses" << std::setw(8) << "MPKI";
+    }
+    out << std::endl;
+    out << std::fixed;
+    for (const auto &phase : sorted) {
+        const Counters &counters = phase.second.counters;
+        out << std::left << std::setw(20) << phase.first << std::right << std::setw(10) << phase.second.calls;
+        if (counted) {
+            double ipc = counters.cycles > 0 ? (double) counters.instructions / counters.cycles : 0;
+            double mpki = counters.instructions > 0 ? 1000.0 * counters.cache_misses / counters.instructions : 0;
+            out << std::setprecision(1) << std::setw(16) << counters.cycles / 1e6 << std::setw(16)
+                << counters.instructions / 1e6 << std::setprecision(2) << std::setw(8) << ipc << std::setw(14)
+                << counters.cache_misses << std::setw(8) << mpki;
+        }
+        out << std::endl;
+    }
+}
@@ -0,0 +1,61 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#ifndef HOMOMORPHICTREEEVALUATOR_PROFILE_H
+#define HOMOMORPHICTREEEVALUATOR_PROFILE_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace COED {
+    /**
+     * A hardware-counter profile of the homomorphic operations. While one exists, every HTE_TRACE span (see Trace.h)
+     * also reads the CPU cycles, retired instructions and last-level cache misses of its thread from Linux's
+     * perf_event_open, and the differences are added up per span name: encryption, each round of compareCtxt,
+     * rotations, multiplications, the leaf polynomial and so on. When the profile is destroyed, it writes one line per
+     * phase to a file, with its calls, counts, instructions per cycle and cache misses per thousand instructions,
+     * which tells whether a phase that got slower is bound by computation or by memory.
+     *
+     * Counters follow the thread that runs a span, so the work of NTL's pool threads is not included; profile with
+     * one core per operation (e.g. --threading static --cores 1) to see all of it. A profile in which spans ran with
+     * more than one thread (see ExecutionPolicy::Lease::threads) starts with a line saying that its counts cover only
+     * the calling threads, and the same is logged. Phases nest (a round of
+     * compareCtxt includes its rotation), so their counts are not meant to be added up. The counters are opened for
+     * user space only, which perf_event_paranoid allows unprivileged processes up to level 2. Where they cannot be
+     * opened, e.g. in a virtual machine without a virtual PMU, only the calls are reported.
+     *
+     * At most one profile exists at a time.
+     */
+    class Profile {
+    public:
+        struct Counters {
+            uint64_t cycles = 0;
+            uint64_t instructions = 0;
+            uint64_t cache_misses = 0;
+        };
+
+        explicit Profile(const std::string &path);
+
+        ~Profile();
+
+        Profile(const Profile &) = delete;
+
+        Profile &operator=(const Profile &) = delete;
+
+        static bool isActive();
+
+        static Counters read();
+
+        static void record(const char *phase, const Counters &begin, const Counters &end);
+
+    private:
+        void print(std::ostream &out) const;
+
+        std::string path;
+    };
+}
+
+#endif //HOMOMORPHICTREEEVALUATOR_PROFILE_H
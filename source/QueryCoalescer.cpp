@@ -0,0 +1,135 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#include "QueryCoalescer.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include "ExecutionPolicy.h"
+#include "Lanes.h"
+#include "MemoryBudget.h"
+#include "TreeEvaluator.h"
+
+/**
+ * @param context the context of the queries.
+ * @param pubkey the key they are encrypted under.
+ * @param options the window and the batch size.
+ */
+QueryCoalescer::QueryCoalescer(helib::Context &context, helib::PubKey &pubkey, const Options &options)
+        : context(context), pubkey(pubkey), ea(context), options(options) {
+    if (options.window_ms < 0 || options.max_batch < 0)
+        throw std::invalid_argument("a coalescing window and batch size cannot be negative");
+    capacity = options.max_batch > 0 ? std::min(options.max_batch, Lanes::count(ea)) : Lanes::count(ea);
+}
+
+/**
+ * Evaluates one query, together with the concurrent queries for the same model. Blocks until its result is ready.
+ * @param inputs one single-query ciphertext per feature of the model.
+ * @param model the model to evaluate.
+ * @return the encrypted result in lane 0, and zero in every other lane.
+ */
+helib::Ctxt QueryCoalescer::evaluate(std::vector<helib::Ctxt> inputs, std::shared_ptr<const EncodedModel> model) {
+    // Checked before the query can open a batch, whose first query sets the shape of every other.
+    if ((int) inputs.size() != model->getTree().getFeatureCount())
+        throw std::invalid_argument("a query needs one ciphertext per feature of the model");
+
+    std::unique_lock<std::mutex> lock(mutex);
+    auto joined = open.find(model.get());
+    if (joined != open.end()) {
+        Batch &batch = *joined->second;
+        queries++;
+        batch.inputs.push_back(std::move(inputs));
+        batch.results.emplace_back();
+        std::future<helib::Ctxt> result = batch.results.back().get_future();
+        if ((long) batch.inputs.size() >= capacity) {
+            open.erase(joined);
+            cv.notify_all();
+        }
+        lock.unlock();
+        return result.get();
+    }
+
+    // This query opens a batch, and runs it once the window ends or the batch is full.
+    std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+    batch->inputs.push_back(std::move(inputs));
+    queries++;
+    batches++;
+    if (capacity > 1) {
+        open[model.get()] = batch;
+        cv.wait_for(lock, std::chrono::duration<double, std::milli>(options.window_ms),
+                    [&] { return (long) batch->inputs.size() >= capacity; });
+        auto still_open = open.find(model.get());
+        if (still_open != open.end() && still_open->second == batch)
+            open.erase(still_open);
+    }
+    lock.unlock();
+
+    std::vector<helib::Ctxt> results;
+    try {
+        results = run(*batch, *model);
+    } catch (...) {
+        for (std::promise<helib::Ctxt> &result : batch->results) {
+            result.set_exception(std::current_exception());
+        }
+        throw;
+    }
+    for (size_t lane = 1; lane < results.size(); lane++) {
+        batch->results[lane - 1].set_value(results[lane]);
+    }
+    return results[0];
+}
+
+/**
+ * Evaluates a closed batch. A query alone is evaluated with evaluate_single_query, which is cheaper than a packed
+ * evaluation; otherwise every query is cleared outside lane 0, so that one client's ciphertext cannot disturb
+ * another's lane, and packed into its own lane.
+ * @param batch the queries, in lane order.
+ * @param model the model they are for.
+ * @return one result per query, in lane 0 and zero elsewhere.
+ */
+std::vector<helib::Ctxt> QueryCoalescer::run(const Batch &batch, const EncodedModel &model) {
+    // The evaluation, and the unpacked results.
+    COED::MemoryBudget::Reservation reservation(model.evaluationBytes() +
+                                                batch.inputs.size() * EncodedModel::ctxtBytes(model.getOne()));
+    COED::ExecutionPolicy::Lease lease;
+    if (batch.inputs.size() == 1) {
+        std::vector<helib::Ctxt> inputs(batch.inputs.front());
+        return {TreeEvaluator::evaluate_single_query(inputs.data(), model, pubkey, context)};
+    }
+
+    helib::Ptxt<helib::BGV> lane = Lanes::mask(context, 0);
+    std::vector<helib::Ctxt> packed_inputs;
+    for (size_t feature = 0; feature < batch.inputs.front().size(); feature++) {
+        std::vector<helib::Ctxt> column;
+        for (const std::vector<helib::Ctxt> &query : batch.inputs) {
+            column.push_back(query[feature]);
+            column.back().multByConstant(lane);
+        }
+        packed_inputs.push_back(Lanes::pack(column, ea));
+    }
+
+    helib::Ctxt result = TreeEvaluator::evaluate_decision_tree(packed_inputs.data(), model, pubkey, context);
+    std::vector<helib::Ctxt> results;
+    for (size_t query = 0; query < batch.inputs.size(); query++) {
+        results.push_back(Lanes::unpack(result, query, ea));
+    }
+    return results;
+}
+
+/**
+ * @return the queries evaluated so far.
+ */
+long QueryCoalescer::getQueries() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return queries;
+}
+
+/**
+ * @return the evaluations they took; getQueries() / getBatches() is the mean batch size.
+ */
+long QueryCoalescer::getBatches() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return batches;
+}
@@ -0,0 +1,78 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#ifndef HOMOMORPHICTREEEVALUATOR_QUERYCOALESCER_H
+#define HOMOMORPHICTREEEVALUATOR_QUERYCOALESCER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "EncodedModel.h"
+
+/**
+ * Merges concurrent single-query evaluations into the lanes of one ciphertext, for servers whose clients each send one
+ * query at a time.
+ *
+ * Every request thread calls evaluate with its own query, as it would call TreeEvaluator::evaluate_single_query. The
+ * first query for a model opens a batch and waits up to the window for others to join; queries for the same model
+ * arriving in the meantime join it. When the window ends or the batch fills all Lanes::count lanes, the query that
+ * opened it evaluates the whole batch once with Lanes::pack and hands every other query its lane with Lanes::unpack,
+ * so each caller still gets a single-query result and the client protocol is unchanged. Under load one evaluation
+ * then serves up to Lanes::count queries; a query arriving alone waits for the window and is evaluated on its own.
+ * The EvaluationScheduler runs its interactive requests through one when it is given a coalescing window.
+ *
+ * With the default parameters a ciphertext has only 2 lanes, so coalescing at most halves the evaluations, however
+ * many queries arrive together. More lanes need larger parameters (a larger m gives more slots); the transposed layout
+ * of BitSlices holds one query per slot instead, BIT_SIZE times as many, at BIT_SIZE ciphertexts per feature.
+ *
+ * The query running a batch takes the COED::MemoryBudget reservation and the COED::ExecutionPolicy lease for all of
+ * it; the queries waiting for their lane hold neither.
+ */
+class QueryCoalescer {
+public:
+    struct Options {
+        // How long the first query of a batch waits for others.
+        double window_ms = 5;
+        // Queries per batch at most; 0 for as many as there are lanes.
+        long max_batch = 0;
+    };
+
+    QueryCoalescer(helib::Context &context, helib::PubKey &pubkey, const Options &options);
+
+    helib::Ctxt evaluate(std::vector<helib::Ctxt> inputs, std::shared_ptr<const EncodedModel> model);
+
+    long getQueries() const;
+
+    long getBatches() const;
+
+private:
+    struct Batch {
+        std::vector<std::vector<helib::Ctxt>> inputs;
+        // The results of the queries that joined, one per query after the first.
+        std::vector<std::promise<helib::Ctxt>> results;
+    };
+
+    std::vector<helib::Ctxt> run(const Batch &batch, const EncodedModel &model);
+
+    helib::Context &context;
+    helib::PubKey &pubkey;
+    helib::EncryptedArray ea;
+    Options options;
+    long capacity;
+
+    mutable std::mutex mutex;
+    std::condition_variable cv;
+    // The batch still open for each model.
+    std::map<const EncodedModel *, std::shared_ptr<Batch>> open;
+    long queries = 0;
+    long batches = 0;
+};
+
+
+#endif //HOMOMORPHICTREEEVALUATOR_QUERYCOALESCER_H
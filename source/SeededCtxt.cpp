@@ -0,0 +1,153 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#include "SeededCtxt.h"
+
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+static const char MAGIC[] = "COEDSEED";
+static const uint64_t FORMAT_VERSION = 1;
+static const size_t MAGIC_BYTES = 8;
+static const size_t HEADER_BYTES = MAGIC_BYTES + sizeof(uint64_t) + COED::SeededCtxt::SEED_BYTES + 2 * sizeof(uint64_t);
+
+static void put(std::string &bytes, uint64_t value) {
+    bytes.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static uint64_t get(const char *bytes) {
+    uint64_t value;
+    std::memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+static std::string serialize(const helib::DoubleCRT &polynomial) {
+    std::ostringstream out;
+    polynomial.write(out);
+    return out.str();
+}
+
+/**
+ * The uniform part of a seeded ciphertext: the same seed gives the same polynomial on the client and the server. It is
+ * drawn from a stream of its own, since DoubleCRT::randomize reseeds the current one.
+ */
+static helib::DoubleCRT expandSeed(const helib::Context &context, const unsigned char *seed) {
+    NTL::RandomStreamPush push;
+    NTL::ZZ value = NTL::ZZFromBytes(seed, COED::SeededCtxt::SEED_BYTES);
+    helib::DoubleCRT a(context, context.ctxtPrimes);
+    a.randomize(&value);
+    return a;
+}
+
+/**
+ * Learns where the parts of a fresh ciphertext sit in its serialization, from one encryption of zero. Everything else
+ * in it (the prime set, the key handles, the plaintext space and the noise bound) is the same for every fresh
+ * ciphertext under {@code secret_key}.
+ * @param secret_key the key queries are encrypted under.
+ */
+COED::SeededCtxt::SeededCtxt(const helib::SecKey &secret_key) : secret_key(secret_key) {
+    const helib::Context &context = secret_key.getContext();
+    // Through the public key interface, whose Encrypt the secret key overrides with secret-key encryption.
+    const helib::PubKey &key = secret_key;
+    helib::Ctxt ctxt(key);
+    key.Encrypt(ctxt, helib::Ptxt<helib::BGV>(context));
+    if (ctxt.partsSize() != 2 || !ctxt[1].skHandle.isBase(0) || ctxt.getPrimeSet() != context.ctxtPrimes)
+        throw std::runtime_error("unexpected fresh ciphertext");
+    ptxt_space = ctxt.getPtxtSpace();
+
+    std::ostringstream out;
+    ctxt.write(out);
+    std::string bytes = out.str();
+    std::string b = serialize(ctxt[0]);
+    std::string a = serialize(ctxt[1]);
+    size_t b_offset = bytes.find(b);
+    size_t a_offset = b_offset == std::string::npos ? b_offset : bytes.find(a, b_offset + b.size());
+    if (a_offset == std::string::npos)
+        throw std::runtime_error("unexpected ciphertext layout");
+    before_b = bytes.substr(0, b_offset);
+    between = bytes.substr(b_offset + b.size(), a_offset - b_offset - b.size());
+    after_a = bytes.substr(a_offset + a.size());
+    b_length = b.size();
+    a_length = a.size();
+}
+
+/**
+ * Encrypts {@code ptxt} straight into the compressed format: a is expanded from a fresh seed, and b = m + p e - a s
+ * is computed directly, as SecKey::Encrypt would with that a.
+ * @param ptxt the plaintext.
+ * @return the compressed ciphertext.
+ */
+std::string COED::SeededCtxt::encrypt(const helib::Ptxt<helib::BGV> &ptxt) const {
+    const helib::Context &context = secret_key.getContext();
+    unsigned char seed[SEED_BYTES];
+    std::random_device entropy;
+    for (long i = 0; i < SEED_BYTES; i += sizeof(unsigned int)) {
+        unsigned int word = entropy();
+        std::memcpy(seed + i, &word, sizeof(word));
+    }
+    helib::DoubleCRT a = expandSeed(context, seed);
+
+    // The noise, with the standard deviation of the context.
+    helib::DoubleCRT b(context, context.ctxtPrimes);
+    b.sampleGaussian();
+    b *= ptxt_space;
+    b += helib::DoubleCRT(ptxt.getPolyRepr(), context, context.ctxtPrimes);
+    a *= secret_key.sKeys.at(0);
+    b -= a;
+
+    std::string b_bytes = serialize(b);
+    if (b_bytes.size() != b_length)
+        throw std::runtime_error("unexpected ciphertext layout");
+    std::string compressed(MAGIC, MAGIC_BYTES);
+    put(compressed, FORMAT_VERSION);
+    compressed.append(reinterpret_cast<const char *>(seed), SEED_BYTES);
+    put(compressed, before_b.size() + b_length + between.size());
+    put(compressed, a_length);
+    compressed.append(before_b);
+    compressed.append(b_bytes);
+    compressed.append(between);
+    compressed.append(after_a);
+    return compressed;
+}
+
+/**
+ * Regenerates the uniform part of a compressed ciphertext and reads it.
+ * @param bytes the output of encrypt.
+ * @param pubkey the client's public key.
+ * @return the ciphertext.
+ */
+helib::Ctxt COED::SeededCtxt::expand(const std::string &bytes, const helib::PubKey &pubkey) {
+    if (bytes.size() < HEADER_BYTES || bytes.compare(0, MAGIC_BYTES, MAGIC, MAGIC_BYTES) != 0)
+        throw std::runtime_error("not a seeded ciphertext");
+    if (get(bytes.data() + MAGIC_BYTES) != FORMAT_VERSION)
+        throw std::runtime_error("unsupported seeded ciphertext version");
+    const char *seed = bytes.data() + MAGIC_BYTES + sizeof(uint64_t);
+    uint64_t a_offset = get(seed + SEED_BYTES);
+    uint64_t a_length = get(seed + SEED_BYTES + sizeof(uint64_t));
+
+    std::string full = bytes.substr(HEADER_BYTES);
+    std::string a = serialize(expandSeed(pubkey.getContext(), reinterpret_cast<const unsigned char *>(seed)));
+    if (a_offset > full.size() || a.size() != a_length)
+        throw std::runtime_error("seeded ciphertext does not match the context");
+    full.insert(a_offset, a);
+
+    std::istringstream in(full);
+    helib::Ctxt ctxt(pubkey);
+    ctxt.read(in);
+    return ctxt;
+}
+
+/**
+ * @param ctxt a ciphertext.
+ * @return the size of {@code ctxt} in Ctxt::write format, for comparison with encrypt.
+ */
+size_t COED::SeededCtxt::uncompressedSize(const helib::Ctxt &ctxt) {
+    std::ostringstream out;
+    ctxt.write(out);
+    return out.str().size();
+}
@@ -0,0 +1,52 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#ifndef HOMOMORPHICTREEEVALUATOR_SEEDEDCTXT_H
+#define HOMOMORPHICTREEEVALUATOR_SEEDEDCTXT_H
+
+#include <string>
+#include <helib/helib.h>
+
+/*
+ * A compressed upload format for fresh ciphertexts encrypted under the client's secret key.
+ *
+ * A fresh ciphertext is a pair (b, a) with b + a * s = m + noise, where a is uniformly random. The client can choose a
+ * as the output of a PRG on a short seed: then only b and the seed have to be sent, and the server regenerates a from
+ * the seed. This roughly halves the upload. Only fresh encryptions can be sent this way.
+ *
+ * Layout, integers 64-bit in host byte order:
+ *      "COEDSEED", format version, seed (SEED_BYTES), offset and length of a in Ctxt::write output, that output
+ *      without a
+ * Locating a by its own serialization keeps the format independent of how HElib lays out the rest of a ciphertext.
+ *
+ * The PRG is a private NTL random stream, so expanding a public seed leaves the thread's stream, which encryption
+ * draws its noise from, as it was.
+ */
+namespace COED {
+    class SeededCtxt {
+    public:
+        static const long SEED_BYTES = 32;
+
+        explicit SeededCtxt(const helib::SecKey &secret_key);
+
+        std::string encrypt(const helib::Ptxt<helib::BGV> &ptxt) const;
+
+        static helib::Ctxt expand(const std::string &bytes, const helib::PubKey &pubkey);
+
+        static size_t uncompressedSize(const helib::Ctxt &ctxt);
+
+    private:
+        const helib::SecKey &secret_key;
+        long ptxt_space;
+        // Ctxt::write output of a fresh ciphertext around its parts: before b, between b and a, and after a.
+        std::string before_b;
+        std::string between;
+        std::string after_a;
+        size_t b_length;
+        size_t a_length;
+    };
+}
+
+#endif //HOMOMORPHICTREEEVALUATOR_SEEDEDCTXT_H
@@ -0,0 +1,253 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#include "Sharding.h"
+
+#include <algorithm>
+#include <csignal>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "Channel.h"
+#include "TreeEvaluator.h"
+
+ShardWorker::ShardWorker(const DecisionTree &tree, const std::vector<int> &nodes, helib::Context &context,
+                         helib::PubKey &pubkey)
+        : context(context), pubkey(pubkey), nodes(nodes) {
+    for (int node : nodes) {
+        features.push_back(tree.getNode(node).feature);
+        tests.push_back(tree.getNode(node));
+    }
+}
+
+/**
+ * Answers queries until {@code in_fd} is closed. A query frame holds a count followed by (feature, ciphertext) pairs;
+ * the reply holds one decision ciphertext per node of this shard.
+ * @param in_fd the descriptor queries arrive on.
+ * @param out_fd the descriptor replies are written to.
+ */
+void ShardWorker::serve(int in_fd, int out_fd) {
+    std::string frame;
+    while (COED::Channel::receive(in_fd, frame)) {
+        std::istringstream query(frame);
+        int count;
+        query >> count;
+        std::map<int, helib::Ctxt> inputs;
+        for (int i = 0; i < count; i++) {
+            int feature;
+            helib::Ctxt ctxt(pubkey);
+            query >> feature >> ctxt;
+            inputs.emplace(feature, ctxt);
+        }
+
+        // Nodes are grouped by feature, so each run of less-than tests of one feature is one compareThresholds pass.
+        std::ostringstream reply;
+        for (size_t first = 0; first < nodes.size();) {
+            const helib::Ctxt &x = inputs.at(features[first]);
+            if (tests[first].test == DecisionTree::Test::RANGE) {
+                reply << TreeEvaluator::compareRange(x, tests[first].threshold, tests[first].upper, context) << "\n";
+                first++;
+                continue;
+            }
+            if (tests[first].test == DecisionTree::Test::EQUAL) {
+                reply << TreeEvaluator::compareEqual(x, tests[first].threshold, context) << "\n";
+                first++;
+                continue;
+            }
+            size_t end = first;
+            std::vector<int> feature_thresholds;
+            while (end < nodes.size() && features[end] == features[first] &&
+                   tests[end].test == DecisionTree::Test::LESS_THAN) {
+                feature_thresholds.push_back(tests[end].threshold);
+                end++;
+            }
+            for (const helib::Ctxt &decision : TreeEvaluator::compareThresholds(x, feature_thresholds, context)) {
+                reply << decision << "\n";
+            }
+            first = end;
+        }
+        if (!COED::Channel::send(out_fd, reply.str()))
+            return;
+    }
+}
+
+/**
+ * Entry point of {@code --shard-worker}: serves a shard over stdin/stdout using only the public key. The first frame
+ * names the nodes of the shard. Anything else the process prints goes to stderr so it cannot corrupt the protocol.
+ * @param public_key_file_path the public key file written by the client.
+ * @param model_path the model file the coordinator was started with.
+ * @return the process exit code.
+ */
+int ShardWorker::main(const std::string &public_key_file_path, const std::string &model_path) {
+    int out_fd = dup(STDOUT_FILENO);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+
+    COED::Encryptor encryptor(public_key_file_path);
+    DecisionTree tree = DecisionTree::load(model_path);
+
+    std::string frame;
+    if (!COED::Channel::receive(STDIN_FILENO, frame))
+        return 1;
+    std::istringstream assignment(frame);
+    std::vector<int> nodes;
+    int node;
+    while (assignment >> node) {
+        nodes.push_back(node);
+    }
+
+    ShardWorker worker(tree, nodes, *encryptor.getContext(), *encryptor.getPublicKey());
+    worker.serve(STDIN_FILENO, out_fd);
+    return 0;
+}
+
+/**
+ * Forks {@code shards} local workers. Create the coordinator before starting other threads: only the forking thread
+ * survives in the children.
+ * @param model the model to evaluate.
+ * @param context the address of the helib::context object.
+ * @param pubkey the client's public key.
+ * @param shards the number of worker processes.
+ */
+ShardCoordinator::ShardCoordinator(std::shared_ptr<const EncodedModel> model, helib::Context &context,
+                                   helib::PubKey &pubkey, int shards)
+        : model(std::move(model)), context(context), pubkey(pubkey) {
+    start({}, shards);
+}
+
+/**
+ * Starts one worker per command through /bin/sh. Each command must run {@code HomomorphicTreeEvaluator --shard-worker
+ * <public key file> <model file>} with the same model, wherever it runs.
+ * @param model the model to evaluate.
+ * @param context the address of the helib::context object.
+ * @param pubkey the client's public key.
+ * @param worker_commands one shell command per worker.
+ */
+ShardCoordinator::ShardCoordinator(std::shared_ptr<const EncodedModel> model, helib::Context &context,
+                                   helib::PubKey &pubkey, const std::vector<std::string> &worker_commands)
+        : model(std::move(model)), context(context), pubkey(pubkey) {
+    start(worker_commands, worker_commands.size());
+}
+
+ShardCoordinator::~ShardCoordinator() {
+    for (Shard &shard : shards) {
+        close(shard.to_worker);
+        close(shard.from_worker);
+    }
+    for (Shard &shard : shards) {
+        waitpid(shard.pid, nullptr, 0);
+    }
+}
+
+void ShardCoordinator::start(const std::vector<std::string> &worker_commands, int count) {
+    // A worker that dies must surface as a failed write, not kill the coordinator.
+    signal(SIGPIPE, SIG_IGN);
+
+    std::vector<std::vector<int>> partitions = ShardCoordinator::partition(model->getTree(), count);
+    for (size_t i = 0; i < partitions.size(); i++) {
+        int to_worker[2], from_worker[2];
+        if (pipe(to_worker) != 0 || pipe(from_worker) != 0)
+            throw std::runtime_error("cannot create pipes for shard worker");
+
+        pid_t pid = fork();
+        if (pid < 0)
+            throw std::runtime_error("cannot fork shard worker");
+        if (pid == 0) {
+            for (Shard &shard : shards) {
+                close(shard.to_worker);
+                close(shard.from_worker);
+            }
+            close(to_worker[1]);
+            close(from_worker[0]);
+            if (worker_commands.empty()) {
+                ShardWorker(model->getTree(), partitions[i], context, pubkey).serve(to_worker[0], from_worker[1]);
+                _exit(0);
+            }
+            dup2(to_worker[0], STDIN_FILENO);
+            dup2(from_worker[1], STDOUT_FILENO);
+            execl("/bin/sh", "sh", "-c", worker_commands[i].c_str(), (char *) nullptr);
+            _exit(127);
+        }
+        close(to_worker[0]);
+        close(from_worker[1]);
+
+        Shard shard{pid, to_worker[1], from_worker[0], partitions[i], {}};
+        for (int node : shard.nodes) {
+            shard.features.push_back(model->getTree().getNode(node).feature);
+        }
+        std::sort(shard.features.begin(), shard.features.end());
+        shard.features.erase(std::unique(shard.features.begin(), shard.features.end()), shard.features.end());
+
+        if (!worker_commands.empty()) {
+            std::ostringstream assignment;
+            for (int node : shard.nodes) {
+                assignment << node << " ";
+            }
+            COED::Channel::send(shard.to_worker, assignment.str());
+        }
+        shards.push_back(shard);
+    }
+}
+
+/**
+ * Splits the nodes of {@code tree} into at most {@code shards} groups of nearly equal size. Nodes are grouped by
+ * feature first, so that each worker needs as few of the query's input ciphertexts as possible.
+ * @param tree the tree to split.
+ * @param shards the number of groups wanted.
+ * @return the node ids of each group.
+ */
+std::vector<std::vector<int>> ShardCoordinator::partition(const DecisionTree &tree, int shards) {
+    std::vector<int> order(tree.getNodeCount());
+    for (int i = 0; i < tree.getNodeCount(); i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&tree](int a, int b) {
+        return tree.getNode(a).feature < tree.getNode(b).feature;
+    });
+
+    shards = std::max(1, std::min(shards, tree.getNodeCount()));
+    std::vector<std::vector<int>> partitions(shards);
+    for (int i = 0; i < tree.getNodeCount(); i++) {
+        partitions[(long) i * shards / tree.getNodeCount()].push_back(order[i]);
+    }
+    return partitions;
+}
+
+/**
+ * Sends the query to every worker, waits for all their decisions and evaluates the leaf polynomial.
+ * @param inputs one single-query ciphertext per feature of the model.
+ * @return the encrypted result.
+ */
+helib::Ctxt ShardCoordinator::evaluate(const std::vector<helib::Ctxt> &inputs) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (Shard &shard : shards) {
+        std::ostringstream query;
+        query << shard.features.size() << "\n";
+        for (int feature : shard.features) {
+            query << feature << "\n" << inputs.at(feature) << "\n";
+        }
+        if (!COED::Channel::send(shard.to_worker, query.str()))
+            throw std::runtime_error("shard worker " + std::to_string(shard.pid) + " is gone");
+    }
+
+    std::vector<helib::Ctxt> decisions(model->getTree().getNodeCount(), helib::Ctxt(pubkey));
+    for (Shard &shard : shards) {
+        std::string frame;
+        if (!COED::Channel::receive(shard.from_worker, frame))
+            throw std::runtime_error("shard worker " + std::to_string(shard.pid) + " is gone");
+        std::istringstream reply(frame);
+        for (int node : shard.nodes) {
+            reply >> decisions[node];
+        }
+    }
+
+    return TreeEvaluator::calculate_result(*model, decisions);
+}
+
+const EncodedModel &ShardCoordinator::getModel() const {
+    return *model;
+}
@@ -0,0 +1,80 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#ifndef HOMOMORPHICTREEEVALUATOR_SHARDING_H
+#define HOMOMORPHICTREEEVALUATOR_SHARDING_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include "EncodedModel.h"
+
+/**
+ * Evaluates the comparisons of one shard of a tree. A worker only ever holds the public key and the thresholds of its
+ * own nodes, which the coordinator assigns grouped by feature. It reads queries from a descriptor and answers each
+ * with the decisions of its nodes, in the order of {@code nodes}.
+ */
+class ShardWorker {
+public:
+    ShardWorker(const DecisionTree &tree, const std::vector<int> &nodes, helib::Context &context,
+                helib::PubKey &pubkey);
+
+    void serve(int in_fd, int out_fd);
+
+    static int main(const std::string &public_key_file_path, const std::string &model_path);
+
+private:
+    helib::Context &context;
+    helib::PubKey &pubkey;
+    std::vector<int> nodes;
+    std::vector<int> features;
+    std::vector<DecisionTree::Node> tests;
+};
+
+/**
+ * Splits the comparisons of a tree across worker processes that share the client's public key, and combines their
+ * decisions in the leaf polynomial. Workers are either forked locally, inheriting the keys copy-on-write, or started
+ * with a shell command each (e.g. through ssh on another machine) running {@code --shard-worker}. Both talk the same
+ * framed protocol over pipes (see COED::Channel).
+ */
+class ShardCoordinator {
+public:
+    ShardCoordinator(std::shared_ptr<const EncodedModel> model, helib::Context &context, helib::PubKey &pubkey,
+                     int shards);
+
+    ShardCoordinator(std::shared_ptr<const EncodedModel> model, helib::Context &context, helib::PubKey &pubkey,
+                     const std::vector<std::string> &worker_commands);
+
+    ~ShardCoordinator();
+
+    helib::Ctxt evaluate(const std::vector<helib::Ctxt> &inputs);
+
+    const EncodedModel &getModel() const;
+
+    static std::vector<std::vector<int>> partition(const DecisionTree &tree, int shards);
+
+private:
+    struct Shard {
+        pid_t pid;
+        int to_worker;
+        int from_worker;
+        std::vector<int> nodes;
+        std::vector<int> features;
+    };
+
+    void start(const std::vector<std::string> &worker_commands, int shards);
+
+    std::shared_ptr<const EncodedModel> model;
+    helib::Context &context;
+    helib::PubKey &pubkey;
+    std::vector<Shard> shards;
+    // The pipes carry one query at a time.
+    std::mutex mutex;
+};
+
+
+#endif //HOMOMORPHICTREEEVALUATOR_SHARDING_H
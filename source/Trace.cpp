@@ -0,0 +1,157 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#include "Trace.h"
+
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unistd.h>
+#include <vector>
+#include "Util.h"
+
+struct TraceEvent {
+    const char *name;
+    double start_us;
+    double duration_us;
+    long capacity_before;
+    long capacity_after;
+};
+
+// The spans of one thread. The mutex is only contended while a session is written.
+struct TraceBuffer {
+    std::mutex mutex;
+    std::vector<TraceEvent> events;
+    int thread;
+};
+
+static std::atomic<bool> trace_active(false);
+static std::chrono::steady_clock::time_point trace_epoch;
+static std::mutex trace_buffers_mutex;
+// Buffers outlive their threads, so that spans of worker threads that have exited are still written.
+static std::vector<std::shared_ptr<TraceBuffer>> trace_buffers;
+
+static TraceBuffer &threadBuffer() {
+    thread_local std::shared_ptr<TraceBuffer> buffer;
+    if (!buffer) {
+        buffer = std::make_shared<TraceBuffer>();
+        std::lock_guard<std::mutex> lock(trace_buffers_mutex);
+        buffer->thread = trace_buffers.size() + 1;
+        trace_buffers.push_back(buffer);
+    }
+    return *buffer;
+}
+
+// The capacity of a ciphertext that has not been encrypted yet is reported as -1.
+static long capacityOf(const helib::Ctxt &ctxt) {
+    return ctxt.isEmpty() ? -1 : ctxt.bitCapacity();
+}
+
+/**
+ * Starts recording spans.
+ * @param path the file the trace is written to when the session ends.
+ */
+COED::Trace::Trace(const std::string &path) : path(path) {
+    if (trace_active)
+        throw std::logic_error("a trace is already being recorded");
+    if (!isCompiledIn())
+        COED::Util::error("Tracing is not compiled in; rebuild with -DHTE_ENABLE_TRACING=ON to record " + path);
+    {
+        std::lock_guard<std::mutex> lock(trace_buffers_mutex);
+        for (const std::shared_ptr<TraceBuffer> &buffer : trace_buffers) {
+            std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+            buffer->events.clear();
+        }
+        trace_epoch = std::chrono::steady_clock::now();
+    }
+    trace_active = true;
+}
+
+/**
+ * Stops recording and writes the trace.
+ */
+COED::Trace::~Trace() {
+    trace_active = false;
+    try {
+        write();
+        COED::Util::info("Trace written to " + path);
+    } catch (const std::exception &e) {
+        COED::Util::error(e.what());
+    }
+}
+
+/**
+ * @return whether HTE_TRACE spans were compiled in.
+ */
+bool COED::Trace::isCompiledIn() {
+#ifdef HTE_ENABLE_TRACING
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * Writes every recorded span as a complete event ("ph": "X"), with the capacities in its arguments.
+ */
+void COED::Trace::write() const {
+    std::ofstream out(path);
+    if (!out)
+        throw std::runtime_error("cannot write trace " + path);
+
+    // Microseconds, to the nanosecond.
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    std::lock_guard<std::mutex> lock(trace_buffers_mutex);
+    for (const std::shared_ptr<TraceBuffer> &buffer : trace_buffers) {
+        std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+        for (const TraceEvent &event : buffer->events) {
+            out << (first ? "\n" : ",\n") << "{\"name\":\"" << event.name << "\",\"cat\":\"he\",\"ph\":\"X\",\"pid\":"
+                << getpid() << ",\"tid\":" << buffer->thread << ",\"ts\":" << event.start_us << ",\"dur\":"
+                << event.duration_us << ",\"args\":{\"capacity_before\":" << event.capacity_before
+                << ",\"capacity_after\":" << event.capacity_after << "}}";
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+    if (!out)
+        throw std::runtime_error("cannot write trace " + path);
+}
+
+/**
+ * Begins a span if a session is recording or a profile is active. Use HTE_TRACE instead, so that the span is
+ * compiled out with tracing.
+ * @param name a string literal naming the operation.
+ * @param ctxt the ciphertext the operation works on; it must outlive the span.
+ */
+COED::Trace::Span::Span(const char *name, const helib::Ctxt *ctxt)
+        : name(name), ctxt(ctxt), capacity_before(0), recording(trace_active),
+          profiling(COED::Profile::isActive()) {
+    if (recording) {
+        capacity_before = capacityOf(*ctxt);
+        start = std::chrono::steady_clock::now();
+    }
+    // Last, so that the counters leave out the span's own bookkeeping.
+    if (profiling)
+        counters_before = COED::Profile::read();
+}
+
+COED::Trace::Span::~Span() {
+    if (profiling && COED::Profile::isActive())
+        COED::Profile::record(name, counters_before, COED::Profile::read());
+    if (!recording || !trace_active)
+        return;
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    TraceEvent event{name, std::chrono::duration<double, std::micro>(start - trace_epoch).count(),
+                     std::chrono::duration<double, std::micro>(end - start).count(), capacity_before,
+                     capacityOf(*ctxt)};
+    TraceBuffer &buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.events.push_back(event);
+}
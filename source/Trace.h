@@ -0,0 +1,80 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#ifndef HOMOMORPHICTREEEVALUATOR_TRACE_H
+#define HOMOMORPHICTREEEVALUATOR_TRACE_H
+
+#include <chrono>
+#include <string>
+#include <helib/helib.h>
+#include "Profile.h"
+
+/**
+ * HTE_TRACE(name, ctxt) records a span from the statement to the end of the enclosing block, together with the
+ * capacity of {@code ctxt} (in bits, see helib::Ctxt::bitCapacity) when the span begins and ends.
+ * HTE_TRACE_OP(name, ctxt, statement) records a span around a single statement, e.g. a rotation of {@code ctxt}.
+ * Spans are only compiled in when HTE_ENABLE_TRACING is defined (cmake -DHTE_ENABLE_TRACING=ON); otherwise
+ * HTE_TRACE expands to nothing, HTE_TRACE_OP to its statement, and {@code ctxt} is not evaluated. The same spans
+ * are the phases of a COED::Profile.
+ */
+#ifdef HTE_ENABLE_TRACING
+#define HTE_TRACE_CONCAT_(a, b) a##b
+#define HTE_TRACE_CONCAT(a, b) HTE_TRACE_CONCAT_(a, b)
+#define HTE_TRACE(name, ctxt) COED::Trace::Span HTE_TRACE_CONCAT(hte_trace_span_, __LINE__)(name, &(ctxt))
+#define HTE_TRACE_OP(name, ctxt, statement) do { HTE_TRACE(name, ctxt); statement; } while (false)
+#else
+#define HTE_TRACE(name, ctxt)
+#define HTE_TRACE_OP(name, ctxt, statement) do { statement; } while (false)
+#endif
+
+namespace COED {
+    /**
+     * A tracing session. While one exists, every HTE_TRACE span finishing on any thread is recorded; when it is
+     * destroyed, the spans are written to a file in the Chrome trace event format, which chrome://tracing and Perfetto
+     * display as one timeline per thread. Each thread appends to its own buffer, so recording does not serialize the
+     * threads it is meant to observe.
+     *
+     * At most one session exists at a time. Spans still open when the session ends are dropped.
+     */
+    class Trace {
+    public:
+        explicit Trace(const std::string &path);
+
+        ~Trace();
+
+        Trace(const Trace &) = delete;
+
+        Trace &operator=(const Trace &) = delete;
+
+        static bool isCompiledIn();
+
+        class Span {
+        public:
+            Span(const char *name, const helib::Ctxt *ctxt);
+
+            ~Span();
+
+            Span(const Span &) = delete;
+
+            Span &operator=(const Span &) = delete;
+
+        private:
+            const char *name;
+            const helib::Ctxt *ctxt;
+            long capacity_before;
+            std::chrono::steady_clock::time_point start;
+            bool recording;
+            bool profiling;
+            Profile::Counters counters_before;
+        };
+
+    private:
+        void write() const;
+
+        std::string path;
+    };
+}
+
+#endif //HOMOMORPHICTREEEVALUATOR_TRACE_H
@@ -4,6 +4,10 @@
 
 #include "TreeEvaluator.h"
 
+#include <algorithm>
+#include "Lanes.h"
+#include "Trace.h"
+
 /**
  * Given an x, stores the binary representation of x in bin. Not that bin[0] contains the MSB and bin[n] contains the
  * LSB of the binary number.
@@ -55,6 +59,7 @@ helib::Ctxt TreeEvaluator::getCtxt(int i, helib::Context &context, helib::PubKey
     if (i == 0) {
         helib::Ptxt<helib::BGV> ptxt_mask(context);
         helib::Ctxt mask = helib::Ctxt(pubkey);
+        HTE_TRACE("getCtxt", mask);
 
         ptxt_mask[0] = 1;
 
@@ -65,6 +70,7 @@ helib::Ctxt TreeEvaluator::getCtxt(int i, helib::Context &context, helib::PubKey
         // Create a ciphertext for carry/sum.
         helib::Ptxt<helib::BGV> ptxt(context);
         helib::Ctxt ctxt = helib::Ctxt(pubkey);
+        HTE_TRACE("getCtxt", ctxt);
 
         (&pubkey)->Encrypt(ctxt, ptxt);
         return ctxt;
@@ -74,6 +80,7 @@ helib::Ctxt TreeEvaluator::getCtxt(int i, helib::Context &context, helib::PubKey
 
         helib::Ptxt<helib::BGV> yPtxt(context);
         helib::Ctxt yCtxt = helib::Ctxt(pubkey);
+        HTE_TRACE("getCtxt", yCtxt);
 
         for (int index = 0; index < 16; index++) {
             yPtxt[index] = y[index];
@@ -99,6 +106,18 @@ void TreeEvaluator::getCtxtList(helib::Context &context, helib::PubKey &pubkey,
     nodes[2] = TreeEvaluator::getCtxt(3, context, pubkey, val[2]);
 }
 
+/**
+ * Encrypts a whole feature vector into one ciphertext, feature f going into lane f (see Lanes.h). This is the upload
+ * format of evaluate_packed_features.
+ *
+ * @param context An object of helib::context
+ * @param pubkey the address of the client's public key.
+ * @param val one value per feature.
+ * @return the packed ciphertext.
+ */
+helib::Ctxt TreeEvaluator::getPackedCtxt(helib::Context &context, helib::PubKey &pubkey, const std::vector<int> &val) {
+    return Lanes::encryptPerLane(context, pubkey, val);
+}
 
 /**
  * In a client-server setting, the client will call this function without any knowledge about the decision tree.
@@ -111,72 +130,352 @@ void TreeEvaluator::getCtxtList(helib::Context &context, helib::PubKey &pubkey,
  */
 helib::Ctxt TreeEvaluator::evaluate_decision_tree(helib::Ctxt input_vector[], helib::PubKey &pubkey, helib::Context
 &context) {
-    int leaves[3] = {10, 20, 30};
-    helib::Ctxt leaf_nodes[3] = {helib::Ctxt(pubkey), helib::Ctxt(pubkey), helib::Ctxt(pubkey)};
-    TreeEvaluator::getCtxtList(context, pubkey, leaf_nodes, leaves);
-
-    // Module 2: Stores ctxt versions of thresholds in threshold
-    // We use modified dummy node, sepal_length < 999 (always the
-    // case), instead of sepal_length > 0 
-    int thold[3] = {-27, -17, -999};
-    helib::Ctxt thresholds[3] = {helib::Ctxt(pubkey), helib::Ctxt(pubkey), helib::Ctxt(pubkey)};
-    TreeEvaluator::getCtxtList(context, pubkey, thresholds, thold);
-
-    helib::Ctxt ctxt_1(pubkey);
-    helib::Ptxt<helib::BGV> ptxt_input(context);
-    ptxt_input[0] = 1;
-    pubkey.Encrypt(ctxt_1, ptxt_input);
+    std::shared_ptr<const EncodedModel> model = EncodedModel::encode(DecisionTree::default_tree(), context, pubkey);
+    return TreeEvaluator::evaluate_decision_tree(input_vector, *model, pubkey, context);
+}
+
+/**
+ * Evaluates an encoded model against an encrypted input vector. Node i of the model compares
+ * {@code input_vector[feature of node i]} against its threshold.
+ *
+ * @param input_vector encrypted input vector, one ciphertext per feature of the model.
+ * @param model the model to evaluate. It is only read, so it can be shared with other queries.
+ * @return an encrypted result obtained after the evaluation of the tree.
+ */
+helib::Ctxt TreeEvaluator::evaluate_decision_tree(helib::Ctxt input_vector[], const EncodedModel &model,
+                                                  helib::PubKey &, helib::Context &context) {
+    const DecisionTree &tree = model.getTree();
+    std::vector<helib::Ctxt> decisions;
+    for (int i = 0; i < tree.getNodeCount(); i++) {
+        decisions.push_back(TreeEvaluator::testNode(input_vector[tree.getNode(i).feature], model, i, context));
+    }
+
+    return TreeEvaluator::calculate_result(model, decisions);
+}
+
+/**
+ * Same result as evaluate_decision_tree, for an input vector that holds a single query in lane 0. Less-than nodes that
+ * test the same feature share one compareThresholds pass instead of running one compareCtxt each. The decisions it
+ * returns carry other nodes' decisions in their other lanes, so the result is cleared outside lane 0.
+ *
+ * @param input_vector encrypted input vector, one single-query ciphertext per feature of the model.
+ * @param model the model to evaluate.
+ * @return an encrypted result obtained after the evaluation of the tree, in lane 0, and zero in every other lane.
+ */
+helib::Ctxt TreeEvaluator::evaluate_single_query(helib::Ctxt input_vector[], const EncodedModel &model,
+                                                 helib::PubKey &, helib::Context &context) {
+    const DecisionTree &tree = model.getTree();
+    std::vector<std::vector<int>> nodes_by_feature(tree.getFeatureCount());
+    std::vector<helib::Ctxt> decisions(tree.getNodeCount(), model.getOne());
+    for (int i = 0; i < tree.getNodeCount(); i++) {
+        const DecisionTree::Node &node = tree.getNode(i);
+        if (node.test == DecisionTree::Test::LESS_THAN) {
+            nodes_by_feature[node.feature].push_back(i);
+        } else {
+            decisions[i] = TreeEvaluator::testNode(input_vector[node.feature], model, i, context);
+        }
+    }
+
+    for (int feature = 0; feature < tree.getFeatureCount(); feature++) {
+        const std::vector<int> &nodes = nodes_by_feature[feature];
+        if (nodes.empty())
+            continue;
+        std::vector<int> thresholds;
+        for (int node : nodes) {
+            thresholds.push_back(tree.getNode(node).threshold);
+        }
+        std::vector<helib::Ctxt> feature_decisions = TreeEvaluator::compareThresholds(input_vector[feature], thresholds,
+                                                                                      context);
+        for (size_t i = 0; i < nodes.size(); i++) {
+            decisions[nodes[i]] = feature_decisions[i];
+        }
+    }
+
+    helib::Ctxt result = TreeEvaluator::calculate_result(model, decisions);
+    result.multByConstant(Lanes::mask(context, 0));
+    return result;
+}
+
+/**
+ * Evaluates a model against a feature vector packed by getPackedCtxt, without the client knowing which node reads
+ * which feature.
+ * The packed features are first routed to node order, so that lane n holds the feature node n tests: the model's
+ * precomputed routing moves every group of lanes that travels the same distance with one masked rotation. All nodes
+ * are then compared in a single compareCtxt against the packed thresholds, and each decision is rotated into lane 0
+ * for the leaf polynomial. The other lanes of those decision ciphertexts hold other nodes' decisions, which the leaf
+ * polynomial, working slot by slot, turns into other lanes of the result; the result is therefore cleared outside
+ * lane 0, so that none of them reaches the client.
+ *
+ * @param features the packed feature vector.
+ * @param model a model for which supportsPackedFeatures() holds.
+ * @return an encrypted result obtained after the evaluation of the tree, in lane 0, and zero in every other lane.
+ */
+helib::Ctxt TreeEvaluator::evaluate_packed_features(const helib::Ctxt &features, const EncodedModel &model,
+                                                    helib::PubKey &, helib::Context &context) {
     helib::EncryptedArray ea(context);
-    helib::totalSums(ea, ctxt_1);
 
-    helib::Ctxt decisions[3] = {helib::Ctxt(pubkey), helib::Ctxt(pubkey), helib::Ctxt(pubkey)};
-    int size = sizeof(thresholds) / sizeof(thresholds[0]);
-    for (int i = 0; i < size; i++) {
-        decisions[i] = TreeEvaluator::compareCtxt(input_vector[i], thresholds[i], context, pubkey);
+    helib::Ctxt routed(features);
+    bool first = true;
+    for (const EncodedModel::Route &route : model.getFeatureRoutes()) {
+        helib::Ctxt moved(features);
+        moved.multByConstant(route.sources);
+        if (route.shift != 0) {
+            HTE_TRACE_OP("rotate", moved, ea.rotate(moved, route.shift * BIT_SIZE));
+        }
+        if (first) {
+            routed = moved;
+            first = false;
+        } else {
+            routed += moved;
+        }
+    }
+
+    helib::Ctxt packed_decisions = TreeEvaluator::compareCtxt(routed, model.getPackedThresholds(), context);
+
+    std::vector<helib::Ctxt> decisions;
+    for (int i = 0; i < model.getTree().getNodeCount(); i++) {
+        decisions.push_back(packed_decisions);
+        if (i != 0) {
+            HTE_TRACE_OP("rotate", decisions.back(), ea.rotate(decisions.back(), -i * BIT_SIZE));
+        }
     }
 
-    return TreeEvaluator::calculate_result(decisions, leaf_nodes, ctxt_1);
+    helib::Ctxt result = TreeEvaluator::calculate_result(model, decisions);
+    result.multByConstant(Lanes::mask(context, 0));
+    return result;
 }
 
 /**
  * Compares two ciphertexts and returns the result.
  * This method compares using 2's complement. If x<y, x-y has '1' as an MSB. The method subtracts the numbers this
  * way, and returns a ciphertext such that it has all 1s if x<y, and all 0s otherwise.
+ * Every lane (see Lanes.h) is compared independently: carries never cross from one lane into the next, and the result
+ * of lane k fills lane k only.
  * @param xCtxt The first ciphertext to be compared.
  * @param yCtxt The second ciphertext to be compared.
  * @param context An address of helib::context object.
- * @param pubkey Address of the client's public key.
  * @return An encryption of x<y.
  */
-helib::Ctxt
-TreeEvaluator::compareCtxt(helib::Ctxt xCtxt, helib::Ctxt yCtxt, helib::Context &context, helib::PubKey &pubkey) {
+helib::Ctxt TreeEvaluator::compareCtxt(helib::Ctxt xCtxt, helib::Ctxt yCtxt, helib::Context &context) {
+    return TreeEvaluator::rippleCompare(xCtxt, yCtxt, 0, context);
+}
+
+/**
+ * Compares one encrypted value against several plaintext thresholds at once.
+ * The value's lane is copied into one lane per threshold (log2 of the number of thresholds rotations), and all copies
+ * are compared in a single pass against a plaintext holding threshold i in lane i. Against a plaintext the first
+ * round of compareCtxt needs no ciphertext multiplication. Each decision is finally rotated into lane 0; the other
+ * lanes of a returned ciphertext hold the other decisions and should be ignored.
+ *
+ * @param xCtxt a single-query ciphertext (zero outside lane 0).
+ * @param thresholds the values to compare against.
+ * @param context An address of helib::context object.
+ * @return one encryption of x < thresholds[i] per threshold, in lane 0.
+ */
+std::vector<helib::Ctxt>
+TreeEvaluator::compareThresholds(const helib::Ctxt &xCtxt, const std::vector<int> &thresholds,
+                                 helib::Context &context) {
+    helib::EncryptedArray ea(context);
+    long lanes = Lanes::count(ea);
+
+    std::vector<helib::Ctxt> decisions;
+    for (size_t first = 0; first < thresholds.size(); first += lanes) {
+        long count = std::min<long>(lanes, thresholds.size() - first);
+
+        helib::Ctxt copies(xCtxt);
+        Lanes::replicate(copies, count, ea);
+
+        std::vector<int> negated;
+        for (long i = 0; i < count; i++) {
+            negated.push_back(-thresholds[first + i]);
+        }
+        helib::Ptxt<helib::BGV> yPtxt = Lanes::encodePerLane(context, negated);
+
+        helib::Ctxt sum(copies);
+        sum.addConstant(yPtxt);
+        helib::Ctxt carry(copies);
+        carry.multByConstant(yPtxt);
+        HTE_TRACE_OP("rotate", carry, ea.rotate(carry, -1));
+        carry.multByConstant(Lanes::clearBitMask(context, BIT_SIZE - 1));
+
+        helib::Ctxt packed = TreeEvaluator::rippleCompare(sum, carry, 1, context);
+        for (long i = 0; i < count; i++) {
+            decisions.push_back(packed);
+            if (i != 0) {
+                HTE_TRACE_OP("rotate", decisions.back(), ea.rotate(decisions.back(), -i * BIT_SIZE));
+            }
+        }
+    }
+    return decisions;
+}
 
-    const int bitLength = 16;
+/**
+ * The ripple-carry subtraction behind compareCtxt, starting at {@code round} with xCtxt and yCtxt holding the partial
+ * sum and carry of the rounds before it.
+ */
+helib::Ctxt TreeEvaluator::rippleCompare(helib::Ctxt xCtxt, helib::Ctxt yCtxt, int round, helib::Context &context) {
 
-    helib::Ctxt mask = TreeEvaluator::getCtxt(0, context, pubkey, 0);
-    helib::Ctxt carry = TreeEvaluator::getCtxt(1, context, pubkey, 0);
-    helib::Ctxt sum = TreeEvaluator::getCtxt(2, context, pubkey, 0);
+    const int bitLength = BIT_SIZE;
 
-    for (int i = 0; i < bitLength; i++) {
+    helib::EncryptedArray ea(context);
+    // After rotating, the LSB of each lane holds the carry out of the next lane's MSB, which must be dropped.
+    helib::Ptxt<helib::BGV> carry_mask = Lanes::clearBitMask(context, bitLength - 1);
+
+    helib::Ctxt carry(yCtxt);
+    helib::Ctxt sum(xCtxt);
+
+    for (int i = round; i < bitLength; i++) {
+        HTE_TRACE("compareCtxt round", sum);
 
         sum = xCtxt;
         sum += yCtxt;
 
+        // The carry of the last round would only be shifted out of the MSB.
+        if (i == bitLength - 1)
+            break;
+
         carry = xCtxt;
         carry *= yCtxt;
 
-        helib::EncryptedArray ea(context);
-        ea.rotate(carry, -1);
+        HTE_TRACE_OP("rotate", carry, ea.rotate(carry, -1));
+        carry.multByConstant(carry_mask);
 
         xCtxt = sum;
         yCtxt = carry;
     }
-    sum *= mask;
-    helib::EncryptedArray ea(context);
-    helib::totalSums(ea, sum);
+    sum.multByConstant(Lanes::bitMask(context, 0));
+    Lanes::broadcastMsb(sum, ea);
     return sum;
 }
 
+/**
+ * Tests {@code lo <= x < hi} in every lane, for lo < hi. The test is x < hi minus x < lo, and each of those is a sum
+ * over bit positions (see lessThanTerms), so both bounds share a single pass that adds up each lane and broadcasts the
+ * result. Costs log2(BIT_SIZE) + 1 levels, where a pair of compareCtxt nodes costs BIT_SIZE - 1 and a multiplication.
+ * @param xCtxt the values to test, one per lane.
+ * @param lo the inclusive lower bound.
+ * @param hi the exclusive upper bound.
+ * @param context An address of helib::context object.
+ * @return all 1s in the lanes where the test holds, all 0s in the others.
+ */
+helib::Ctxt TreeEvaluator::compareRange(const helib::Ctxt &xCtxt, int lo, int hi, helib::Context &context) {
+    helib::EncryptedArray ea(context);
+    helib::Ctxt result = TreeEvaluator::lessThanTerms(xCtxt, hi, ea);
+    // Modulo 2, subtracting is adding.
+    result += TreeEvaluator::lessThanTerms(xCtxt, lo, ea);
+    TreeEvaluator::sumLanes(result, ea);
+    return result;
+}
+
+/**
+ * Tests {@code x == value} in every lane: the product of the lane's bits of x + value + 1, in log2(BIT_SIZE) levels.
+ * @param xCtxt the values to test, one per lane.
+ * @param value the value to compare against.
+ * @param context An address of helib::context object.
+ * @return all 1s in the lanes where x equals the value, all 0s in the others.
+ */
+helib::Ctxt TreeEvaluator::compareEqual(const helib::Ctxt &xCtxt, int value, helib::Context &context) {
+    helib::EncryptedArray ea(context);
+    helib::Ctxt equal(xCtxt);
+    equal.addConstant(Lanes::encodeReplicated(context, value));
+    equal.addConstant(1L);
+    TreeEvaluator::prefixProducts(equal, ea);
+    // The LSB of each lane holds the product of the whole lane; move it to the MSB.
+    HTE_TRACE_OP("rotate", equal, ea.rotate(equal, -(BIT_SIZE - 1)));
+    equal.multByConstant(Lanes::bitMask(context, 0));
+    Lanes::broadcastMsb(equal, ea);
+    return equal;
+}
+
+/**
+ * Evaluates the test of one node of a model, whatever its kind.
+ * @param xCtxt the node's feature, one value per lane.
+ * @param model the model.
+ * @param node the node.
+ * @param context An address of helib::context object.
+ * @return all 1s in the lanes where the test holds, all 0s in the others.
+ */
+helib::Ctxt TreeEvaluator::testNode(const helib::Ctxt &xCtxt, const EncodedModel &model, int node,
+                                    helib::Context &context) {
+    const DecisionTree::Node &n = model.getTree().getNode(node);
+    switch (n.test) {
+        case DecisionTree::Test::RANGE:
+            return TreeEvaluator::compareRange(xCtxt, n.threshold, n.upper, context);
+        case DecisionTree::Test::EQUAL:
+            return TreeEvaluator::compareEqual(xCtxt, n.threshold, context);
+        default:
+            return TreeEvaluator::compareCtxt(xCtxt, model.getThreshold(node), context);
+    }
+}
+
+/**
+ * Replaces every bit of every lane by the product of the bits from the lane's MSB up to it, in log2(BIT_SIZE)
+ * rotations and levels.
+ * @param ctxt the bits.
+ * @param ea the EncryptedArray of the context.
+ */
+void TreeEvaluator::prefixProducts(helib::Ctxt &ctxt, const helib::EncryptedArray &ea) {
+    for (int shift = 1; shift < BIT_SIZE; shift *= 2) {
+        helib::Ctxt shifted(ctxt);
+        HTE_TRACE_OP("rotate", shifted, ea.rotate(shifted, shift));
+        // The first bits of a lane received the end of the previous lane; they multiply by 1 instead.
+        shifted.multByConstant(Lanes::bitRangeMask(ctxt.getContext(), shift, BIT_SIZE));
+        shifted.addConstant(Lanes::bitRangeMask(ctxt.getContext(), 0, shift));
+        HTE_TRACE_OP("multiplyBy", ctxt, ctxt.multiplyBy(shifted));
+    }
+}
+
+/**
+ * The terms of x < value against a plaintext value, one per bit position: bit i of a lane is 1 iff x and the value
+ * agree on every bit before i and x has 0 where the value has 1. At most one term per lane is 1, so the lane's sum is
+ * the comparison. Flipping both sign bits turns the two's complement order into the unsigned one.
+ * @param xCtxt the values to compare, one per lane.
+ * @param value the value to compare against.
+ * @param ea the EncryptedArray of the context.
+ * @return the terms, in log2(BIT_SIZE) + 1 levels.
+ */
+helib::Ctxt TreeEvaluator::lessThanTerms(const helib::Ctxt &xCtxt, int value, const helib::EncryptedArray &ea) {
+    const helib::Context &context = xCtxt.getContext();
+    helib::Ptxt<helib::BGV> sign = Lanes::bitMask(context, 0);
+    helib::Ptxt<helib::BGV> yPtxt = Lanes::encodeReplicated(context, value);
+    helib::Ctxt flipped(xCtxt);
+    flipped.addConstant(sign);
+
+    // Agreement on every bit before i: the prefix products of x + y + 1, shifted one bit down.
+    helib::Ctxt agree(xCtxt);
+    agree.addConstant(yPtxt);
+    agree.addConstant(1L);
+    TreeEvaluator::prefixProducts(agree, ea);
+    HTE_TRACE_OP("rotate", agree, ea.rotate(agree, 1));
+    agree.multByConstant(Lanes::bitRangeMask(context, 1, BIT_SIZE));
+    agree.addConstant(sign);
+
+    // (1 + x'_i) y'_i, where x' and y' have their sign bits flipped.
+    helib::Ptxt<helib::BGV> flipped_y = yPtxt;
+    flipped_y += sign;
+    helib::Ctxt terms(flipped);
+    terms.addConstant(1L);
+    terms.multByConstant(flipped_y);
+    HTE_TRACE_OP("multiplyBy", terms, terms.multiplyBy(agree));
+    return terms;
+}
+
+/**
+ * Replaces every lane by the sum of its bits, in every bit position.
+ * @param ctxt the bits to add up.
+ * @param ea the EncryptedArray of the context.
+ */
+void TreeEvaluator::sumLanes(helib::Ctxt &ctxt, const helib::EncryptedArray &ea) {
+    for (int shift = 1; shift < BIT_SIZE; shift *= 2) {
+        helib::Ctxt shifted(ctxt);
+        HTE_TRACE_OP("rotate", shifted, ea.rotate(shifted, -shift));
+        ctxt += shifted;
+    }
+    // The MSB of each lane now holds the sum of the lane.
+    ctxt.multByConstant(Lanes::bitMask(ctxt.getContext(), 0));
+    Lanes::broadcastMsb(ctxt, ea);
+}
+
 
 /**
  * This is an internal, private function to TreeEvaluator.
@@ -191,9 +490,9 @@ helib::Ctxt
 TreeEvaluator::calculate_result(helib::Ctxt decisions[], helib::Ctxt leaf_nodes[], const helib::Ctxt &ctxt_1) {
     // calculate decision[0]*(decision[2]*leaf_nodes[0]) (call it term0)
     helib::Ctxt temp(decisions[2]);
-    temp.multiplyBy(leaf_nodes[0]);
+    HTE_TRACE_OP("multiplyBy", temp, temp.multiplyBy(leaf_nodes[0]));
     helib::Ctxt term0(decisions[0]);
-    term0.multiplyBy(temp);
+    HTE_TRACE_OP("multiplyBy", term0, term0.multiplyBy(temp));
 
 
     // calculate 1-decision[0] (call it term1)
@@ -204,12 +503,12 @@ TreeEvaluator::calculate_result(helib::Ctxt decisions[], helib::Ctxt leaf_nodes[
     // calculate (1-decision[1])*leaf_nodes[2] (call it term2)
     helib::Ctxt one_minus_ctxt_1(ctxt_1);
     one_minus_ctxt_1.addCtxt(decisions[1], true);
-    one_minus_ctxt_1.multiplyBy(leaf_nodes[2]);
+    HTE_TRACE_OP("multiplyBy", one_minus_ctxt_1, one_minus_ctxt_1.multiplyBy(leaf_nodes[2]));
     helib::Ctxt term2(one_minus_ctxt_1);
 
     // calculate decision[1]*leaf_nodes[1] (call it term3)
     helib::Ctxt term3(decisions[1]);
-    term3.multiplyBy(leaf_nodes[1]);
+    HTE_TRACE_OP("multiplyBy", term3, term3.multiplyBy(leaf_nodes[1]));
 
 
     // calculate term2+term3 (call it term4)
@@ -217,7 +516,7 @@ TreeEvaluator::calculate_result(helib::Ctxt decisions[], helib::Ctxt leaf_nodes[
     helib::Ctxt term4(term2);
 
     // multiply term4 with term1 (call it term5)
-    term4.multiplyBy(term1);
+    HTE_TRACE_OP("multiplyBy", term4, term4.multiplyBy(term1));
     helib::Ctxt term5(term4);
 
     /*Finally, add terms 0 and 5, effectively calculating the following expression:
@@ -227,3 +526,16 @@ TreeEvaluator::calculate_result(helib::Ctxt decisions[], helib::Ctxt leaf_nodes[
 
     return term5;
 }
+
+
+/**
+ * The generic counterpart of calculate_result above: evaluates the leaf polynomial of any tree, compiled by
+ * LeafPolynomial into balanced path products so that it costs log2 rather than linear depth in the tree's depth.
+ *
+ * @param model the model whose tree and leaf values are used.
+ * @param decisions one encrypted decision per node of the tree, as returned by compareCtxt.
+ * @return a single ciphertext that is the result of evaluation of the tree.
+ */
+helib::Ctxt TreeEvaluator::calculate_result(const EncodedModel &model, const std::vector<helib::Ctxt> &decisions) {
+    return model.getPolynomial().evaluate(model, decisions);
+}
@@ -6,9 +6,12 @@
 #define HOMOMORPHICTREEEVALUATOR_TREEEVALUATOR_H
 #define BIT_SIZE 16
 
+#include "EncodedModel.h"
 #include "Encryptor.h"
 #include "Util.h"
 
+void getBin(int x, int *bin);
+
 class TreeEvaluator {
 public:
     static helib::Ctxt getCtxt(int i, helib::Context &context, helib::PubKey &pubkey, int val);
@@ -16,13 +19,43 @@ public:
     static helib::Ctxt evaluate_decision_tree(helib::Ctxt input_vector[], helib::PubKey &pubkey, helib::Context
     &context);
 
+    static helib::Ctxt evaluate_decision_tree(helib::Ctxt input_vector[], const EncodedModel &model,
+                                              helib::PubKey &pubkey, helib::Context &context);
+
+    static helib::Ctxt evaluate_single_query(helib::Ctxt input_vector[], const EncodedModel &model,
+                                             helib::PubKey &pubkey, helib::Context &context);
+
+    static helib::Ctxt evaluate_packed_features(const helib::Ctxt &features, const EncodedModel &model,
+                                                helib::PubKey &pubkey, helib::Context &context);
+
     static helib::Ctxt calculate_result(helib::Ctxt decisions[], helib::Ctxt leaf_nodes[], const helib::Ctxt &ctxt_1);
 
-    static helib::Ctxt
-    compareCtxt(helib::Ctxt xCtxt, helib::Ctxt yCtxt, helib::Context &context, helib::PubKey &pubkey);
+    static helib::Ctxt calculate_result(const EncodedModel &model, const std::vector<helib::Ctxt> &decisions);
+
+    static helib::Ctxt compareCtxt(helib::Ctxt xCtxt, helib::Ctxt yCtxt, helib::Context &context);
+
+    static std::vector<helib::Ctxt>
+    compareThresholds(const helib::Ctxt &xCtxt, const std::vector<int> &thresholds, helib::Context &context);
+
+    static helib::Ctxt compareRange(const helib::Ctxt &xCtxt, int lo, int hi, helib::Context &context);
+
+    static helib::Ctxt compareEqual(const helib::Ctxt &xCtxt, int value, helib::Context &context);
+
+    static helib::Ctxt testNode(const helib::Ctxt &xCtxt, const EncodedModel &model, int node,
+                                helib::Context &context);
+
+    static helib::Ctxt getPackedCtxt(helib::Context &context, helib::PubKey &pubkey, const std::vector<int> &val);
 
     static void getCtxtList(helib::Context &context, helib::PubKey &pubkey, helib::Ctxt *nodes, int *val);
 
+private:
+    static helib::Ctxt rippleCompare(helib::Ctxt xCtxt, helib::Ctxt yCtxt, int round, helib::Context &context);
+
+    static void prefixProducts(helib::Ctxt &ctxt, const helib::EncryptedArray &ea);
+
+    static helib::Ctxt lessThanTerms(const helib::Ctxt &xCtxt, int value, const helib::EncryptedArray &ea);
+
+    static void sumLanes(helib::Ctxt &ctxt, const helib::EncryptedArray &ea);
 };
 
 
@@ -0,0 +1,90 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include "ExecutionPolicy.h"
+#include "MemoryBudget.h"
+#include "LoadGenerator.h"
+#include "Profile.h"
+#include "Trace.h"
+
+int main(int argc, char *argv[]) {
+    // --depth <d> --nodes <n> --features <f> --seed <s>: the synthetic model.
+    // --concurrency <c>: queries in flight at once.
+    // --rate <q>: queries per second, 0 (the default) to send them back to back.
+    // --queries <n>: how many queries to send.
+    // --engine bgv|ckks: the bit circuits of TreeEvaluator (the default) or CkksEngine.
+    // --update <k>: re-score in sessions, changing k features per query (see EvaluationSession).
+    // --upload full|seeded: send queries as Ctxt::write output (the default) or as SeededCtxt.
+    // --coalesce <ms>: merge queries arriving within <ms> of each other into one evaluation, see QueryCoalescer.
+    // --threading adaptive|static|pinned: split the cores between workers and NTL's threads, see ExecutionPolicy.
+    // --cores <n>: the cores --threading uses, all by default.
+    // --memory-cap <MiB>: the ciphertext memory queries in flight may take together, see MemoryBudget.
+    // --trace <file>: write a timeline of the homomorphic operations to <file>, see Trace.h.
+    // --profile <file>: write the hardware counters of each kind of homomorphic operation to <file>, see Profile.h.
+    LoadGenerator::Options options;
+    std::string trace_path;
+    std::string profile_path;
+    std::string threading;
+    COED::ExecutionPolicy::Options policy;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag(argv[i]), value(argv[i + 1]);
+        if (flag == "--depth")
+            options.depth = std::stoi(value);
+        else if (flag == "--nodes")
+            options.nodes = std::stoi(value);
+        else if (flag == "--features")
+            options.features = std::stoi(value);
+        else if (flag == "--seed")
+            options.seed = std::stoul(value);
+        else if (flag == "--concurrency")
+            options.concurrency = std::stoi(value);
+        else if (flag == "--rate")
+            options.rate = std::stod(value);
+        else if (flag == "--queries")
+            options.queries = std::stol(value);
+        else if (flag == "--engine" && (value == "bgv" || value == "ckks"))
+            options.ckks = value == "ckks";
+        else if (flag == "--update")
+            options.updated_features = std::stoi(value);
+        else if (flag == "--upload" && (value == "full" || value == "seeded"))
+            options.seeded_uploads = value == "seeded";
+        else if (flag == "--coalesce")
+            options.coalesce_ms = std::stod(value);
+        else if (flag == "--threading")
+            threading = value;
+        else if (flag == "--cores")
+            policy.cores = std::stoi(value);
+        else if (flag == "--memory-cap")
+            COED::MemoryBudget::configure(std::stoul(value) << 20);
+        else if (flag == "--trace")
+            trace_path = value;
+        else if (flag == "--profile")
+            profile_path = value;
+        else {
+            std::cerr << "unknown option " << flag << std::endl;
+            return 1;
+        }
+    }
+
+    if (!threading.empty()) {
+        policy.mode = COED::ExecutionPolicy::parseMode(threading);
+        policy.query_threads = std::max(1, options.concurrency);
+        COED::ExecutionPolicy::configure(policy);
+    }
+
+    std::unique_ptr<COED::Trace> trace;
+    if (!trace_path.empty())
+        trace.reset(new COED::Trace(trace_path));
+    std::unique_ptr<COED::Profile> profile;
+    if (!profile_path.empty())
+        profile.reset(new COED::Profile(profile_path));
+    LoadGenerator::print(LoadGenerator::run(options), std::cout);
+    return 0;
+}
@@ -4,12 +4,167 @@
 //
 
 
+#include <algorithm>
 #include <iostream>
+#include <memory>
+#include <string>
+#include "BulkScorer.h"
 #include "Client.h"
+#include "CostEstimator.h"
+#include "EncryptedAggregate.h"
+#include "EvaluationScheduler.h"
+#include "ExecutionPolicy.h"
+#include "MemoryBudget.h"
+#include "Profile.h"
+#include "Sharding.h"
+#include "Trace.h"
+
+int main(int argc, char *argv[]) {
+    // --shard-worker <public key> <model>: serve one shard of a sharded evaluation over stdin/stdout.
+    if (argc == 4 && std::string(argv[1]) == "--shard-worker") {
+        return ShardWorker::main(argv[2], argv[3]);
+    }
+
+    // --model <path>: evaluate the tree in <path> and reload it whenever the file changes.
+    // --models <directory>: serve every model file in <directory>; each query starts with a model ID.
+    // --shards <n>: split the comparisons across n local worker processes.
+    // --coalesce <ms>: let concurrent queries wait up to <ms> milliseconds to share one evaluation, see QueryCoalescer.
+    // --keys <directory> <id>: look up each client's key in <directory>, see KeyCache; this process is client <id>.
+    // --upload full|seeded: have the client send queries as ciphertexts (the default) or as SeededCtxt.
+    // --dry-run: only report what evaluating the model would cost with the default parameters.
+    // --score <input csv> <output csv>: score every row of the input offline, resuming an interrupted job.
+    // --workers <n>: the number of threads --score evaluates on, by default one per core.
+    // --aggregate mean|histogram <input csv>: only the mean score or the leaf histogram of the input, see
+    // EncryptedAggregate.
+    // --layout lanes|bitsliced: how --score packs rows, one per lane (default) or one per slot, see BitSlices.
+    // --ciphertexts <file>: also keep the encrypted scores of --score in <file>, see CtxtFile.h.
+    // --threading adaptive|static|pinned: split the cores between queries and NTL's threads, see ExecutionPolicy.
+    // --cores <n>: the cores --threading uses, all by default.
+    // --memory-cap <MiB>: the ciphertext memory evaluations in flight may take together, see MemoryBudget.
+    // --trace <file>: write a timeline of the homomorphic operations to <file>, see Trace.h.
+    // --profile <file>: write the hardware counters of each kind of homomorphic operation to <file>, see Profile.h.
+    std::string model_path;
+    std::string models_directory;
+    int shards = 0;
+    double coalesce_ms = 0;
+    bool seeded_uploads = false;
+    std::string keys_directory;
+    std::string client_id;
+    bool dry_run = false;
+    std::string trace_path;
+    std::string profile_path;
+    std::string threading;
+    COED::ExecutionPolicy::Options policy;
+    BulkScorer::Options scoring;
+    std::string layout = "lanes";
+    std::string aggregate;
+    std::string aggregate_path;
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--model" && i + 1 < argc)
+            model_path = argv[++i];
+        else if (std::string(argv[i]) == "--models" && i + 1 < argc)
+            models_directory = argv[++i];
+        else if (std::string(argv[i]) == "--shards" && i + 1 < argc)
+            shards = std::stoi(argv[++i]);
+        else if (std::string(argv[i]) == "--coalesce" && i + 1 < argc)
+            coalesce_ms = std::stod(argv[++i]);
+        else if (std::string(argv[i]) == "--keys" && i + 2 < argc) {
+            keys_directory = argv[++i];
+            client_id = argv[++i];
+        } else if (std::string(argv[i]) == "--upload" && i + 1 < argc)
+            seeded_uploads = std::string(argv[++i]) == "seeded";
+        else if (std::string(argv[i]) == "--dry-run")
+            dry_run = true;
+        else if (std::string(argv[i]) == "--score" && i + 2 < argc) {
+            scoring.input_path = argv[++i];
+            scoring.output_path = argv[++i];
+        } else if (std::string(argv[i]) == "--aggregate" && i + 2 < argc) {
+            aggregate = argv[++i];
+            aggregate_path = argv[++i];
+        } else if (std::string(argv[i]) == "--workers" && i + 1 < argc)
+            scoring.workers = std::stoi(argv[++i]);
+        else if (std::string(argv[i]) == "--layout" && i + 1 < argc)
+            layout = argv[++i];
+        else if (std::string(argv[i]) == "--ciphertexts" && i + 1 < argc)
+            scoring.ciphertext_path = argv[++i];
+        else if (std::string(argv[i]) == "--trace" && i + 1 < argc)
+            trace_path = argv[++i];
+        else if (std::string(argv[i]) == "--profile" && i + 1 < argc)
+            profile_path = argv[++i];
+        else if (std::string(argv[i]) == "--threading" && i + 1 < argc)
+            threading = argv[++i];
+        else if (std::string(argv[i]) == "--cores" && i + 1 < argc)
+            policy.cores = std::stoi(argv[++i]);
+        else if (std::string(argv[i]) == "--memory-cap" && i + 1 < argc)
+            COED::MemoryBudget::configure(std::stoul(argv[++i]) << 20);
+    }
+
+    if (!threading.empty()) {
+        policy.mode = COED::ExecutionPolicy::parseMode(threading);
+        // Bulk scoring evaluates on its workers; otherwise queries are evaluated on the EvaluationScheduler's.
+        policy.query_threads = scoring.input_path.empty() ? EvaluationScheduler::Options().workers
+                                                          : std::max(1, scoring.workers);
+        COED::ExecutionPolicy::configure(policy);
+    }
+
+    if (layout != "lanes" && layout != "bitsliced") {
+        COED::Util::error("unknown layout " + layout);
+        return 1;
+    }
+    scoring.bit_sliced = layout == "bitsliced";
+
+    std::unique_ptr<COED::Trace> trace;
+    if (!trace_path.empty())
+        trace.reset(new COED::Trace(trace_path));
+    std::unique_ptr<COED::Profile> profile;
+    if (!profile_path.empty())
+        profile.reset(new COED::Profile(profile_path));
+
+    if (dry_run) {
+        DecisionTree tree = model_path.empty() ? DecisionTree::default_tree() : DecisionTree::load(model_path);
+        CostEstimator::Parameters parameters;
+        std::cout << "== One ciphertext per feature (evaluate_decision_tree)" << std::endl;
+        CostEstimator::print(CostEstimator::estimate(tree, parameters, CostEstimator::Layout::PER_FEATURE),
+                             parameters, std::cout);
+        std::cout << "== One ciphertext per feature, shared comparisons (evaluate_single_query)" << std::endl;
+        CostEstimator::print(CostEstimator::estimate(tree, parameters, CostEstimator::Layout::SINGLE_QUERY),
+                             parameters, std::cout);
+        std::cout << "== Packed features (evaluate_packed_features)" << std::endl;
+        CostEstimator::print(CostEstimator::estimate(tree, parameters, CostEstimator::Layout::PACKED_FEATURES),
+                             parameters, std::cout);
+        std::cout << "== Bit-sliced, one query per slot (BitSlices::evaluate)" << std::endl;
+        CostEstimator::print(CostEstimator::estimate(tree, parameters, CostEstimator::Layout::BIT_SLICED),
+                             parameters, std::cout);
+        return 0;
+    }
+
+    if (!aggregate.empty()) {
+        DecisionTree tree = model_path.empty() ? DecisionTree::default_tree() : DecisionTree::load(model_path);
+        EncryptedAggregate::run(aggregate_path, tree, EncryptedAggregate::parseKind(aggregate), std::cout);
+        return 0;
+    }
+
+    if (!scoring.input_path.empty()) {
+        COED::Encryptor encryptor = Client::createEncryptor();
+        DecisionTree tree = model_path.empty() ? DecisionTree::default_tree() : DecisionTree::load(model_path);
+        BulkScorer scorer(encryptor, EncodedModel::encode(tree, *encryptor.getContext(), *encryptor.getPublicKey()),
+                          scoring);
+        long rows = scorer.run();
+        COED::Util::info("Scored " + std::to_string(rows) + " rows into " + scoring.output_path);
+        return 0;
+    }
+
+    if (!models_directory.empty() && shards > 0) {
+        COED::Util::error("--models cannot be combined with --shards");
+        return 1;
+    }
+    if (!keys_directory.empty() && (!models_directory.empty() || shards > 0)) {
+        COED::Util::error("--keys cannot be combined with --models or --shards");
+        return 1;
+    }
 
-int main() {
     std::cout << "Program Start!!!" << std::endl;
-    Client::main();
+    Client::main(model_path, models_directory, shards, coalesce_ms, seeded_uploads, keys_directory, client_id);
     std::cout << "Program Finished!!!" << std::endl;
     return 0;
 }
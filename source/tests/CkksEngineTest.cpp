@@ -0,0 +1,102 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "CkksEngine.h"
+
+/**
+ * Writes {@code text} as a model file and loads it.
+ */
+static DecisionTree loadModel(const std::string &text) {
+    const std::string model_path = "ckks_engine_test.tree";
+    {
+        std::ofstream model(model_path);
+        model << text;
+    }
+    DecisionTree tree = DecisionTree::load(model_path);
+    std::remove(model_path.c_str());
+    return tree;
+}
+
+/**
+ * Evaluates {@code rows} under encryption and compares each result with the plaintext tree.
+ * @return the number of rows decided differently.
+ */
+static int check(const CkksEngine &engine, const DecisionTree &tree, const std::vector<std::vector<double>> &rows) {
+    std::shared_ptr<const CkksEngine::Model> model = engine.encode(tree);
+    for (const std::vector<double> &row : rows) {
+        engine.checkRange(tree, row);
+    }
+    std::vector<double> results = engine.decrypt(engine.evaluate(*model, engine.encrypt(rows)), rows.size());
+
+    int failures = 0;
+    for (size_t i = 0; i < rows.size(); i++) {
+        int expected = tree.classify(rows[i]);
+        if (std::abs(results[i] - expected) > 0.5) {
+            std::cerr << "row (" << rows[i][0];
+            for (size_t feature = 1; feature < rows[i].size(); feature++) {
+                std::cerr << ", " << rows[i][feature];
+            }
+            std::cerr << "): expected " << expected << ", got " << results[i] << std::endl;
+            failures++;
+        }
+    }
+    return failures;
+}
+
+/*
+ * Checks that CkksEngine decides like the plaintext tree: integral features that sit exactly on a bound of a node (an
+ * exact match of an equality test, the lower and upper bound of a range test and the threshold of a less-than test),
+ * and real-valued features just either side of integer and fractional thresholds.
+ */
+int main() {
+    CkksEngine engine{CkksEngine::Parameters()};
+
+    DecisionTree integral = loadModel("features 2\n"
+                                      "integer 0 1\n"
+                                      "equal 0 0 7 l0 n1\n"
+                                      "range 1 1 10 20 l1 n2\n"
+                                      "node 2 1 25 l2 l3\n"
+                                      "leaf 0 100\n"
+                                      "leaf 1 200\n"
+                                      "leaf 2 300\n"
+                                      "leaf 3 400\n");
+    const std::vector<std::vector<double>> integral_rows = {
+            {7, 0},   // equal to the value
+            {6, 0},   // one below the value, below the range
+            {8, 10},  // on the lower bound of the range
+            {8, 19},  // one below the upper bound
+            {8, 20},  // on the upper bound
+            {8, 25},  // on the threshold
+            {8, 24},  // one below the threshold
+    };
+
+    // Real-valued features are compared at the thresholds themselves, so rows stay a little over the tolerance of
+    // about 1/4 (see CkksEngine.h) away from them.
+    DecisionTree real = loadModel("features 1\n"
+                                  "node 0 0 25 n1 l2\n"
+                                  "range 1 0 10.25 20.75 l0 l1\n"
+                                  "leaf 0 100\n"
+                                  "leaf 1 200\n"
+                                  "leaf 2 300\n");
+    const std::vector<std::vector<double>> real_rows = {
+            {24.7},   // below the threshold, within 1/2 of it
+            {25.3},   // above the threshold
+            {10.55},  // just inside the fractional lower bound
+            {9.95},   // just below it
+            {20.45},  // just inside the fractional upper bound
+            {21.05},  // just above it
+    };
+
+    int failures = check(engine, integral, integral_rows) + check(engine, real, real_rows);
+    size_t rows = integral_rows.size() + real_rows.size();
+    std::cout << rows - failures << " of " << rows << " rows decided as in the clear" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
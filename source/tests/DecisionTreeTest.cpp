@@ -0,0 +1,124 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "DecisionTree.h"
+
+/**
+ * Writes {@code text} as a model file and loads it.
+ * @return the error load threw, or an empty string if it loaded.
+ */
+static std::string loadError(const std::string &text) {
+    const std::string model_path = "decision_tree_test.tree";
+    {
+        std::ofstream model(model_path);
+        model << text;
+    }
+    std::string error;
+    try {
+        DecisionTree::load(model_path);
+    } catch (const std::exception &e) {
+        error = e.what();
+        if (error.empty()) {
+            error = "(empty message)";
+        }
+    }
+    std::remove(model_path.c_str());
+    return error;
+}
+
+/*
+ * Checks that DecisionTree::load accepts values at the edges of what a lane evaluates correctly and rejects, with the
+ * line where there is one, thresholds the comparison would wrap on, leaf values a client cannot decode, ids defined
+ * twice and malformed child references; and that a fractional threshold decides integer and real features alike.
+ */
+int main() {
+    const std::string tree = "features 1\n"
+                             "node 0 0 THRESHOLD l0 l1\n"
+                             "leaf 0 LEFT\n"
+                             "leaf 1 65535\n";
+    auto model = [&](const std::string &threshold, const std::string &left) {
+        std::string text = tree;
+        text.replace(text.find("THRESHOLD"), 9, threshold);
+        text.replace(text.find("LEFT"), 4, left);
+        return text;
+    };
+
+    struct Case {
+        std::string description;
+        std::string text;
+        // A part of the expected error, or empty if the model is valid.
+        std::string error;
+    };
+    const std::vector<Case> cases = {
+            {"lowest threshold",           model("-16384", "0"),                                ""},
+            {"highest threshold",          model("16383", "0"),                                 ""},
+            {"threshold below the range",  model("-16385", "0"),                                "outside"},
+            {"threshold above the range",  model("16384", "0"),                                 "outside"},
+            {"threshold that wraps",       model("-32768", "0"),                                "outside"},
+            {"negative leaf",              model("0", "-5"),                                    "leaf value -5"},
+            {"leaf wider than a lane",     model("0", "70000"),                                 "leaf value 70000"},
+            {"duplicate node",             model("0", "0") + "node 0 0 1 l1 l0\n",              "line 5"},
+            {"duplicate leaf",             model("0", "0") + "leaf 1 7\n",                      "line 5"},
+            {"non-numeric child",          "features 1\nnode 0 0 1 nx l0\nleaf 0 1\n",          "line 2"},
+            {"child with trailing text",   "features 1\nnode 0 0 1 l0x l0\nleaf 0 1\n",         "line 2"},
+            {"child out of int range",     "features 1\nnode 0 0 1 l99999999999 l0\nleaf 0 1\n", "line 2"},
+            {"fractional threshold",       model("24.5", "0"),                                  ""},
+            {"fractional equality value",  "features 1\nequal 0 0 2.5 l0 l0\nleaf 0 1\n",       "line 2"},
+            {"integral feature",           "features 2\ninteger 1\nnode 0 1 2 l0 l0\nleaf 0 1\n", ""},
+            {"unknown integral feature",   "features 1\ninteger 1\nnode 0 0 2 l0 l0\nleaf 0 1\n", "line 2"},
+    };
+
+    int failures = 0;
+    for (const Case &c : cases) {
+        std::string error = loadError(c.text);
+        bool passed = c.error.empty() ? error.empty() : error.find(c.error) != std::string::npos;
+        if (!passed) {
+            std::cerr << c.description << ": expected " << (c.error.empty() ? "no error" : "'" + c.error + "'")
+                      << ", got " << (error.empty() ? "no error" : "'" + error + "'") << std::endl;
+            failures++;
+        }
+    }
+
+    for (long value : {-16384L, 16383L}) {
+        if (!DecisionTree::fitsLane(value)) {
+            std::cerr << value << " should fit a lane" << std::endl;
+            failures++;
+        }
+    }
+    for (long value : {-16385L, 16384L, -32768L, 32767L}) {
+        if (DecisionTree::fitsLane(value)) {
+            std::cerr << value << " should not fit a lane" << std::endl;
+            failures++;
+        }
+    }
+
+    const std::string fractional_path = "decision_tree_test.tree";
+    {
+        std::ofstream file(fractional_path);
+        file << model("24.5", "0");
+    }
+    DecisionTree fractional = DecisionTree::load(fractional_path);
+    std::remove(fractional_path.c_str());
+    for (int value : {24, 25}) {
+        if (fractional.classify(std::vector<int>{value}) != fractional.classify(std::vector<double>{(double) value})) {
+            std::cerr << value << " < 24.5 decided differently as an integer and as a real" << std::endl;
+            failures++;
+        }
+    }
+    if (fractional.classify(std::vector<double>{24.4}) != 0 ||
+        fractional.classify(std::vector<double>{24.6}) != 65535) {
+        std::cerr << "24.4 and 24.6 should fall either side of 24.5" << std::endl;
+        failures++;
+    }
+
+    std::cout << cases.size() - failures << " of " << cases.size() << " models handled as expected" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,80 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Encryptor.h"
+#include "KeyCache.h"
+
+/**
+ * Generates a key pair and writes its public key as client {@code id} of the current directory.
+ */
+static void writeKey(const std::string &id, long bits) {
+    const std::string secret_key_path = id + "_sk.txt";
+    const std::string public_key_path = id + "_pk.txt";
+    COED::Encryptor encryptor(secret_key_path, public_key_path, 2, 2665, 1, bits, 2);
+    std::remove(secret_key_path.c_str());
+    std::remove(public_key_path.c_str());
+    encryptor.writePublicKeyBinary("./" + id + ".pk");
+}
+
+/*
+ * Checks that KeyCache shares one context between clients with identical parameters, builds another for different
+ * parameters, and evicts the least recently used key beyond its memory budget.
+ */
+int main() {
+    const std::string a = "key_cache_test_a";
+    const std::string b = "key_cache_test_b";
+    const std::string c = "key_cache_test_c";
+    writeKey(a, 512);
+    writeKey(b, 512);
+    writeKey(c, 300);
+
+    int failures = 0;
+    auto expect = [&](bool condition, const std::string &what) {
+        if (!condition) {
+            std::cerr << what << std::endl;
+            failures++;
+        }
+    };
+
+    {
+        KeyCache keys(".", 1UL << 30);
+        std::shared_ptr<KeyCache::ClientKeys> key_a = keys.get(a);
+        std::shared_ptr<KeyCache::ClientKeys> key_b = keys.get(b);
+        expect(key_a->context == key_b->context, "clients with identical parameters do not share a context");
+        expect(keys.getContextCount() == 1, "expected 1 context, got " + std::to_string(keys.getContextCount()));
+        std::shared_ptr<KeyCache::ClientKeys> key_c = keys.get(c);
+        expect(key_c->context != key_a->context, "clients with different parameters share a context");
+        expect(keys.getContextCount() == 2, "expected 2 contexts, got " + std::to_string(keys.getContextCount()));
+        expect(keys.get(a) == key_a, "a cached key was loaded again");
+        expect(keys.getHits() == 1 && keys.getMisses() == 3,
+               "expected 1 hit and 3 misses, got " + std::to_string(keys.getHits()) + " and " +
+               std::to_string(keys.getMisses()));
+    }
+
+    {
+        // Room for one key only: loading b evicts a, which is then loaded again.
+        size_t key_bytes = KeyCache(".", 1UL << 30).get(a)->bytes;
+        KeyCache keys(".", key_bytes + key_bytes / 2);
+        keys.get(a);
+        keys.get(b);
+        expect(keys.getCachedBytes() <= key_bytes + key_bytes / 2, "the cached keys exceed the budget");
+        std::shared_ptr<KeyCache::ClientKeys> key_a = keys.get(a);
+        expect(keys.getHits() == 0 && keys.getMisses() == 3,
+               "expected a to have been evicted, got " + std::to_string(keys.getHits()) + " hits");
+        expect(key_a->pubkey != nullptr, "the reloaded key has no public key");
+    }
+
+    for (const std::string &id : {a, b, c}) {
+        std::remove(("./" + id + ".pk").c_str());
+    }
+    std::cout << (failures == 0 ? "KeyCache shares contexts and evicts as expected" : "KeyCache checks failed")
+              << std::endl;
+    return failures == 0 ? 0 : 1;
+}
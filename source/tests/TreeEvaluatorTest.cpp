@@ -0,0 +1,148 @@
+//
+// Copyright SpiRITlab - Computations on Encrypted Data
+// https://gitlab.com/SpiRITlab/coed
+//
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "AsyncClient.h"
+#include "BitSlices.h"
+#include "DecisionTree.h"
+#include "EncodedModel.h"
+#include "Encryptor.h"
+#include "EvaluationScheduler.h"
+#include "TreeEvaluator.h"
+
+/*
+ * Checks the encrypted comparisons of TreeEvaluator and BitSlices at the edges of DecisionTree::fitsLane, where a
+ * feature and a threshold of opposite signs are furthest apart, and that a single query's result leaves the server with its value in
+ * lane 0 and zeros in every other lane: the model is encoded into every lane, so an unmasked result would hand the
+ * client the tree evaluated on the other lanes.
+ */
+int main() {
+    const std::string secret_key_path = "tree_evaluator_test_sk.txt";
+    const std::string public_key_path = "tree_evaluator_test_pk.txt";
+    COED::Encryptor encryptor(secret_key_path, public_key_path, 2, 2665, 1, 512, 2);
+    std::remove(secret_key_path.c_str());
+    std::remove(public_key_path.c_str());
+    helib::Context &context = *encryptor.getContext();
+    helib::PubKey &pubkey = *encryptor.getPublicKey();
+    const helib::EncryptedArray &ea = *encryptor.getEncryptedArray();
+
+    auto decrypt = [&](const helib::Ctxt &ctxt) {
+        std::vector<long> slots(ea.size());
+        ea.decrypt(ctxt, *encryptor.getSecretKey(), slots);
+        return slots;
+    };
+
+    // Feature, threshold.
+    const std::vector<std::pair<int, int>> comparisons = {
+            {16383,  -16384},
+            {-16384, 16383},
+            {-16384, -16384},
+            {16383,  16383},
+            {-1,     0},
+            {0,      -1},
+    };
+
+    int failures = 0;
+    for (const std::pair<int, int> &comparison : comparisons) {
+        int x = comparison.first;
+        int t = comparison.second;
+        if (!DecisionTree::fitsLane(x) || !DecisionTree::fitsLane(t)) {
+            std::cerr << x << " < " << t << ": outside the range of a lane" << std::endl;
+            failures++;
+            continue;
+        }
+        long expected = x < t ? 1 : 0;
+        helib::Ctxt xCtxt = TreeEvaluator::getCtxt(3, context, pubkey, x);
+
+        helib::Ctxt against_ctxt = TreeEvaluator::compareCtxt(xCtxt, TreeEvaluator::getCtxt(3, context, pubkey, -t),
+                                                              context);
+        long compared = decrypt(against_ctxt)[0];
+        long thresholded = decrypt(TreeEvaluator::compareThresholds(xCtxt, {t}, context).at(0))[0];
+        long sliced = decrypt(BitSlices::lessThan(BitSlices::encrypt(pubkey, ea, {x}), t))[0];
+        if (compared != expected || thresholded != expected || sliced != expected) {
+            std::cerr << x << " < " << t << ": expected " << expected << ", compareCtxt gave " << compared
+                      << ", compareThresholds " << thresholded << " and BitSlices::lessThan " << sliced << std::endl;
+            failures++;
+        }
+    }
+    std::cout << comparisons.size() - failures << " of " << comparisons.size() << " comparisons decided as in the clear"
+              << std::endl;
+
+    DecisionTree tree = DecisionTree::default_tree();
+    std::shared_ptr<const EncodedModel> model = EncodedModel::encode(tree, context, pubkey);
+    const std::vector<int> row = {30, 10, 5};
+    std::vector<helib::Ctxt> inputs;
+    for (int feature : row) {
+        inputs.push_back(TreeEvaluator::getCtxt(3, context, pubkey, feature));
+    }
+
+    // Checks one way of serving a query.
+    int served = 0;
+    auto check = [&](const std::string &path, const helib::Ctxt &result, long expected) {
+        served++;
+        std::vector<long> slots = decrypt(result);
+        long value = AsyncClient::decode(slots, 1)[0];
+        size_t stray = 0;
+        for (size_t i = BIT_SIZE; i < slots.size(); i++) {
+            stray += slots[i] != 0;
+        }
+        if (value != expected || stray != 0) {
+            std::cerr << path << ": expected " << expected << " and zeros, got " << value << " and " << stray
+                      << " non-zero slots outside lane 0" << std::endl;
+            failures++;
+        }
+    };
+
+    check("single query", TreeEvaluator::evaluate_single_query(inputs.data(), *model, pubkey, context),
+          tree.classify(row));
+
+    EvaluationScheduler::Options scheduling;
+    scheduling.workers = 2;
+    EvaluationScheduler scheduler(context, pubkey, scheduling);
+    for (EvaluationScheduler::Priority priority : {EvaluationScheduler::Priority::INTERACTIVE,
+                                                   EvaluationScheduler::Priority::BULK}) {
+        EvaluationScheduler::Admission admission = scheduler.submit(inputs, model, priority);
+        if (!admission.accepted) {
+            std::cerr << "query rejected: " << admission.reason << std::endl;
+            failures++;
+            continue;
+        }
+        check(priority == EvaluationScheduler::Priority::INTERACTIVE ? "interactive" : "bulk", admission.result.get(),
+              tree.classify(row));
+    }
+
+    // A tree small enough for the packed feature layout: one node and one feature per lane.
+    const std::string model_path = "tree_evaluator_test.tree";
+    {
+        std::ofstream file(model_path);
+        file << "features 2\n"
+                "node 0 0 10 l0 n1\n"
+                "node 1 1 20 l1 l2\n"
+                "leaf 0 100\n"
+                "leaf 1 200\n"
+                "leaf 2 300\n";
+    }
+    DecisionTree small_tree = DecisionTree::load(model_path);
+    std::remove(model_path.c_str());
+    std::shared_ptr<const EncodedModel> small_model = EncodedModel::encode(small_tree, context, pubkey);
+    if (!small_model->supportsPackedFeatures()) {
+        std::cerr << "the small tree should support packed features" << std::endl;
+        failures++;
+    } else {
+        for (const std::vector<int> &small_row : std::vector<std::vector<int>>{{5, 0}, {15, 25}, {15, 5}}) {
+            helib::Ctxt features = TreeEvaluator::getPackedCtxt(context, pubkey, small_row);
+            check("packed features", TreeEvaluator::evaluate_packed_features(features, *small_model, pubkey, context),
+                  small_tree.classify(small_row));
+        }
+    }
+
+    std::cout << served << " queries checked for stray lanes" << std::endl;
+    return failures == 0 ? 0 : 1;
+}